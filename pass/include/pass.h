@@ -11,7 +11,46 @@
 
 #define PASS_DATA_HEADER_SIZE 42
 
+#define PASS_HEADER_VERSION_1  1
+#define PASS_HEADER_VERSION_2  2   // carries the payload length, frames are not confirmed by the next header
+#define PASS_FORMAT_INT16      1
+
+/* frames sent over udp are cut into fragments that fit a 1500 byte mtu */
+#define PASS_FRAGMENT_SIZE         1472
+#define PASS_FRAGMENT_HEADER_SIZE  12
+#define PASS_FRAGMENT_PAYLOAD      (PASS_FRAGMENT_SIZE - PASS_FRAGMENT_HEADER_SIZE)
+
+/* frames published to shared memory, one copy for every consumer on the host */
+#define PASS_SHM_MAGIC   0x73736170   // "pass"
+#define PASS_SHM_ALIGN   64
+
+#define PASS_OCTAVE_BAND_SMALLEST 10
+#define PASS_OCTAVE_BAND_LARGEST  53
+
+/* pass_context_init flags */
+#define PASS_FLAG_IO_URING     (1 << 0)   // ingest through io_uring, read() when the kernel lacks support
+#define PASS_FLAG_CHECKSUM     (1 << 1)   // drop frames whose payload does not match the header checksum
+#define PASS_FLAG_ENDIAN_SWAP  (1 << 2)   // big endian samples, swapped as they are converted or written
+
+/* pass_fftw_plan_init flags */
+#define PASS_PLAN_SINGLE   (1 << 0)   // float32 transform with fftwf, arrays from pass_array_allocate_single
+#define PASS_PLAN_MEASURE  (1 << 1)   // FFTW_MEASURE instead of FFTW_ESTIMATE, worth it with pass_fftw_wisdom
+#define PASS_PLAN_PATIENT  (1 << 2)   // FFTW_PATIENT, slower still to plan
+
+/* how pass_fftw_execute computes the spectrum, see pass_fftw_plan_init_pruned */
+#define PASS_ENGINE_FFT        0   // every bin of the frame
+#define PASS_ENGINE_DECIMATE   1   // halfband decimation by two until just the needed bins fit, then a short transform
+#define PASS_ENGINE_GOERTZEL   2   // one goertzel filter per needed bin
+
+#define PASS_DECIMATION_STAGES  16
+
+/* frequency weightings of IEC 61672, see pass_fftw_plan_weighting */
+#define PASS_WEIGHTING_Z  0   // flat
+#define PASS_WEIGHTING_A  1
+#define PASS_WEIGHTING_C  2
+
 #include <fftw3.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -22,87 +61,408 @@ typedef enum {
 	PASS_FAILURE_GENERIC,
 	PASS_FAILURE_NOMEM,
 	PASS_FAILURE_NO_CONN,
-	PASS_FAILURE_NO_DATA
+	PASS_FAILURE_NO_DATA,
+	PASS_FAILURE_CHECKSUM
 } pass_response;
 
+/* a band as a run of bins, the first and last weighted by how much of them it covers */
+typedef struct {
+	int lower;
+	int upper;
+
+	double lower_weight;
+	double upper_weight;
+} pass_octave_band;
+
 typedef struct {
 	int sample_rate;
-	int output_rate;
+	int frame_size;    // transform length, samples per frame
+	int output_rate;   // bins, (frame_size / 2) + 1
+
+	double bin_width;  // in Hz, sample_rate / frame_size
+
+	int octave_fraction;   // 1/octave_fraction octave bands, 3 unless pass_fftw_plan_bands says otherwise
+	int octave_smallest;   // number of the first band in octave_bands
+	int octave_bands_count;
+	pass_octave_band *octave_bands;  // bin indices and edge weights at bin_width
+	int weighting;                   // PASS_WEIGHTING_*
+	double *octave_weights;          // power gain of each band at its centre, NULL for PASS_WEIGHTING_Z
+
+	int flags;         // PASS_PLAN_*
+	int transforms;    // sensor_count * channel_count from pass_fftw_plan_init_many, 1 otherwise
+
+	/* pass_fftw_plan_init_pruned, output_rate is then upper + 1 */
+	int engine;        // PASS_ENGINE_*
+	int lower;         // first bin needed
+	int upper;         // last bin needed
+	int transform_size;  // samples transformed after decimation
+
+	int stages;                                  // decimations by two
+	int halfband_count[PASS_DECIMATION_STAGES];  // odd coefficients on one side of each halfband filter
+	double *halfband[PASS_DECIMATION_STAGES];    // h[1], h[3], ... the centre is 0.5 and the even ones 0
+
+	double *windowed;  // frame_size samples ahead of decimation
+	double *decimated; // 3 * frame_size / 4 samples of decimation work space
 
 	fftw_plan plan_forward;
 	fftw_complex *result;
 
 	double *input;
 	double *window;
+
+	/* PASS_PLAN_SINGLE */
+	fftwf_plan plan_forward_f;
+	fftwf_complex *result_f;
+
+	float *input_f;
+	float *window_f;
 } pass_fftw_plan;
 
 typedef struct {
 	double scale; 
         
 	int filename_length;
-	int duration;
-	int seconds_written;
+	int duration;          // in seconds
+	int samples_written;   // into the current file
         
 	char *directory;
 	char *filename;
 	char *prefix;
 } pass_wav_description;
 
+/*
+ * Welch averaging over a stream: segments of segment samples start every hop
+ * samples, overlapping when hop < segment, and averages of their power
+ * spectra make up each estimate. Samples left over carry into the next frame.
+ * When hop * averages is shorter than a frame, only the last estimate of the
+ * frame is returned and the earlier ones are counted in superseded.
+ */
 typedef struct {
-	int count;   /* current number of bytes stored */
-	int total;   /* maximum number of bytes that can be stored */
+	int segment;      // samples per transform, the frame_size of the plan used
+	int hop;          // samples from the start of one segment to the next
+	int averages;     // segments per estimate
 
-	unsigned char *buffer;
-} scratch_bytes;
+	int filled;       // samples waiting in buffer
+	int skip;         // samples still to drop when hop > segment
+	int accumulated;  // segments summed so far
+	int superseded;   // estimates replaced by a later one in the same frame, never returned
 
+	double *buffer;   // segment samples
+	double *sum;      // (segment / 2) + 1 powers
+	double *estimate; // the latest average, copied out once the frame is consumed
+} pass_welch;
+
+typedef struct {
+	int start;   /* offset of the first unconsumed byte */
+	int count;   /* current number of bytes stored */
+	int total;   /* maximum number of bytes that can be stored */
+	bool overflowed;  /* emptied when full, not yet reported as a gap */
+
+	unsigned char *buffer;  /* total bytes, mapped twice back to back */
+} pass_ring;
+
+/*
+ * The data header, little endian. Version 1 leaves the fields after version
+ * to the source; version 2 fills in the sequence, the payload length and
+ * shape, in what used to be id and reserved, so framing needs no scanning.
+ */
+typedef struct __attribute__ ((__packed__)) {
+	uint64_t magic;       // 0xc0c0c0c0c0c0c0c0
+	uint64_t sequence;    // v2, frame number
+	uint64_t version;
+	uint64_t timestamp;
+	uint32_t length;      // v2, payload bytes
+	uint16_t format;      // v2, PASS_FORMAT_INT16
+	uint8_t  sensors;     // v2
+	uint8_t  channels;    // v2
+	int16_t  checksum;
+} pass_header;
+
+/* precedes every fragment, fields in network byte order */
+typedef struct __attribute__ ((__packed__)) {
+	uint32_t sequence;   // frame the fragment belongs to
+	uint32_t length;     // bytes in the whole frame, header included
+	uint16_t index;      // fragment number within the frame
+	uint16_t count;      // fragments in the frame
+} pass_fragment_header;
+
+/*
+ * Start of a shm:// segment, slot_count slots of slot_size bytes follow at
+ * PASS_SHM_ALIGN. A slot is a uint64_t sequence padded to PASS_SHM_ALIGN and
+ * then the frame; the sequence is odd while the producer writes the slot and
+ * 2 * (frame number + 1) once the frame is complete.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	uint32_t frame_bytes;   // header included
+	uint32_t futex;         // bumped on every publish
+	uint32_t waiters;       // consumers blocked on futex
+	uint32_t closed;        // non zero once the producer is done
+	uint32_t reserved;
+	uint64_t published;     // frames published
+} pass_shm_header;
+
+/*
+ * Samples, a spectrum or bands: only the first count values are meaningful,
+ * stages neither read nor clear anything between count and total. Stages take
+ * the array as float32 whenever values_f is not NULL, so an array built by
+ * hand rather than by pass_array_allocate or pass_array_allocate_single has to
+ * leave the one it does not use NULL, as a zeroed or designated initialiser does.
+ */
 typedef struct {
 	uint64_t sequence_id;
 
-	int count;
-	int total;
+	int count;   // values held
+	int total;   // values allocated
 
 	double *values;
+	float *values_f;   // instead of values, from pass_array_allocate_single
 } pass_array;
 
+/*
+ * Running sums of a power spectrum, built once a frame, from which the power
+ * of any run of bins is two lookups, so octave bands, bins and custom ranges
+ * all come from the one spectrum. The sums are compensated, sum[k] + carry[k]
+ * holds what rounding would otherwise lose over a few hundred thousand bins.
+ */
+typedef struct {
+	uint64_t sequence_id;
+
+	int count;       // bins summed, sum and carry hold count + 1 values
+	int total;       // bins allocated for
+
+	double *sum;     // sum[k], the power of bins 0 to k - 1
+	double *carry;   // compensation for sum[k]
+} pass_cumulative;
+
+/* one octave of the bank, its rate halved from the level above */
+typedef struct {
+	double sample_rate;
+
+	int lower;         // first band measured at this level
+	int upper;         // one past the last, equal to lower when the level only decimates
+
+	int halfband_count;   // odd coefficients of the halfband into the next level
+	double *halfband;
+	double *history;      // input not yet past the halfband's reach
+	int history_count;
+
+	pass_array samples;   // this level's samples of the frame, then its spectrum
+	pass_fftw_plan plan;  // frame_size is the segment
+	pass_welch welch;
+	bool estimated;
+} pass_octave_level;
+
+/*
+ * Constant percentage bandwidth analysis: each band is measured at the lowest
+ * rate that still holds it, on short overlapping transforms. State carries
+ * across frames, so frame length no longer sets the low band resolution.
+ * Every level's window is scaled for its own segment, so the bands are mean
+ * squares like those of a full transform.
+ */
+typedef struct {
+	int lower;         // first band number
+	int upper;         // one past the last
+
+	int levels;
+	pass_octave_level *level;
+
+	double *values;    // latest mean square of each band
+} pass_octave_bank;
+
+#define PASS_IIR_SECTIONS  3   // biquads per band, a sixth order bandpass
+
+/*
+ * One rate of the iir bank, for every channel at once. Samples are stored
+ * [sample * channels + channel], coefficients and state section by band by
+ * channel, [(section * bands + band) * channels + channel], so each step of a
+ * section runs across the level's bands and channels in one loop.
+ */
+typedef struct {
+	double sample_rate;
+
+	int lower;         // first band filtered at this level
+	int upper;         // one past the last, equal to lower when the level only decimates
+
+	int halfband_count;   // odd coefficients of the halfband into the next level
+	double *halfband;
+	double *history;      // input not yet past the halfband's reach
+	int history_count;
+
+	double *samples;      // this level's samples of the block, channels interleaved
+	int count;            // samples of each channel
+
+	double weight;        // of each new squared output in the running level, 0 averages each call
+	double *gain;         // b0 of each section, b1 is 0 and b2 is -b0
+	double *a1;
+	double *a2;
+	double *z1;           // transposed direct form II state
+	double *z2;
+	double *output;       // a band's sample on its way through the sections
+	double *squares;      // sum of the squared outputs over the call
+	int squared;          // samples of each channel in the sums
+} pass_iir_level;
+
+/*
+ * Time domain 1/3 octave analysis in the manner of IEC 61260: each band is a
+ * sixth order Butterworth bandpass, filtered at the lowest rate that holds
+ * it, and squared into a mean square that is time weighted like a sound
+ * level meter's. Levels are ready after every call, however short.
+ */
+typedef struct {
+	int lower;         // first band number
+	int upper;         // one past the last
+
+	double time_constant;  // seconds, 0.125 fast, 1.0 slow, 0 for the mean square of each call
+	int frame_size;        // most samples of each channel given to one call
+	int channels;
+
+	int levels;
+	pass_iir_level *level;
+
+	double *values;        // time weighted mean square of each band, [band * channels + channel]
+	double *mean_squares;  // unweighted, over the last call
+	double *highest;       // of values, over the last call
+	double *lowest;
+	double *weights;       // power gain of each band, NULL for PASS_WEIGHTING_Z
+} pass_iir_bank;
+
+/*
+ * Summaries of a stream of band or bin powers: Leq, the energy average over
+ * each interval, and the largest and smallest of the exponentially time
+ * weighted values within it. Values stay powers, pass_decibels turns them
+ * into levels.
+ */
+typedef struct {
+	int count;             // values per input, fixed for the interval
+	int total;             // values allocated
+
+	double interval;       // seconds each summary covers, 0 summarises every input
+	double time_constant;  // seconds, 0.125 fast, 1.0 slow, 0 takes the inputs as already weighted
+	double elapsed;        // seconds into the interval
+	bool primed;           // the running values hold the stream's first input or later
+
+	double *energy;        // sum of value * seconds over the interval
+	double *running;       // time weighted values
+	double *highest;       // of running, over the interval
+	double *lowest;
+
+	pass_array leq;        // the last complete interval
+	pass_array lmax;
+	pass_array lmin;
+} pass_meter;
+
+struct pass_datagram;
+struct pass_shm;
+struct pass_uring;
+
 typedef struct {
 	uint64_t sequence_id;
 
 	int sensor_count;
 	int channel_count;
 	int sample_rate;
+	int frame_size;          // samples per channel in each frame
 	int header_size;         // in bytes
 	int single_sample_size;  // in bytes, assuming sizeof(short)
 
 	int sd;
+	int flags;                  // PASS_FLAG_*
+
+	pass_ring ring;
+	struct pass_uring *uring;   // io_uring ingest state, NULL when reading with read()
+
+	struct pass_datagram *datagram;   // udp reassembly state, NULL on a stream
+	struct pass_shm *shm;             // shared memory cursor, NULL on a stream
+	uint64_t fragments_lost;          // udp only, fragments of frames that never completed
+	uint64_t frames_lost;             // udp and shm, frames that never completed or were overwritten
+	uint64_t frames_corrupt;          // with PASS_FLAG_CHECKSUM, frames dropped on a checksum mismatch
 
-	scratch_bytes scratch;
+	bool in_sync;                  // framing locked, pass_read scatters into sync_header/sync_payload
+	bool placed;                   // pass_read placed a whole frame that pass_gaps_detection has not handed out
+	unsigned char *sync_header;
+	short *sync_payload;
 
-	short *input;
-	short *payload;
-	unsigned char *header;
+	short *payload;          // view into ring or sync_payload, valid until the next pass_read
+	unsigned char *header;   // view into ring or sync_header, valid until the next pass_read
 	double *values;
 } pass_context;
 
+typedef void (*pass_pool_task)(
+	void *,   // user data
+	int,      // task, 0 to tasks - 1
+	int);     // worker, 0 to workers - 1, for per worker plans and buffers
+
+/*
+ * Runs the tasks of a batch, typically one per sensor and channel of a
+ * frame, on the workers. The calling thread is worker 0 and the batch is
+ * joined before pass_pool_run returns.
+ */
+typedef struct {
+	int workers;
+	pthread_t *threads;   /* workers - 1 */
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;      /* a batch was posted or the pool is stopping */
+	pthread_cond_t finished;   /* the last task of the batch completed */
+
+	pass_pool_task task;
+	void *user_data;
+
+	int count;       /* tasks in the batch */
+	int next;        /* next task to hand out */
+	int completed;   /* tasks run so far */
+	uint64_t batch;  /* bumped for every pass_pool_run */
+	bool stop;
+} pass_pool;
+
+typedef void (*pass_frame_callback)(
+	pass_context *,
+	pass_response,   // PASS_SUCCESS with a frame, PASS_FAILURE_GAP_DETECTED or PASS_FAILURE_CHECKSUM
+	void *);         // user data
+
+typedef struct {
+	pass_context *pc;
+	pass_frame_callback callback;
+	void *user_data;
+} pass_reactor_stream;
+
+typedef struct {
+	int epoll_fd;
+
+	int count;   /* number of streams added */
+	int active;  /* number of streams still connected */
+	int total;   /* maximum number of streams */
+
+	pass_reactor_stream *streams;
+} pass_reactor;
+
 
 pass_response  pass_array_allocate(pass_array *, const int);
 
+pass_response  pass_array_allocate_single(pass_array *, const int);
+
 pass_response  pass_array_free(pass_array *);
 
 void           pass_close(pass_context *);
 
 pass_response  pass_connect(
 	pass_context *,
-	const char *,   // host
+	const char *,   // host, udp://group to receive fragmented frames, or shm://name
 	const char *);  // port
 
 pass_response  pass_context_free(pass_context *);
 
 pass_response  pass_context_init(
 	pass_context *,
-	int,    // sensor_count
-	int,    // channel_count
+	int,    // sensor_count, v2 headers hold at most 255
+	int,    // channel_count, likewise
 	int,    // sample_rate
-	bool);  // contains_header
+	int,    // frame_size, samples per channel in each frame
+	bool,   // contains_header
+	int);   // flags, PASS_FLAG_*
 
 pass_response pass_convert_to_doubles(
 	pass_array *,
@@ -112,6 +472,31 @@ pass_response pass_convert_to_doubles(
 	const double,   // gradient
 	const double);  // offset
 
+pass_response  pass_cumulative_bands(  // pass_octave_bands from the running sums
+	const pass_cumulative *,
+	pass_array *,        // band powers out, sized for upper - lower
+	const pass_fftw_plan *,
+	const int,    // lower band number
+	const int);   // upper band number
+
+pass_response  pass_cumulative_bins(  // power of each run of stride bins, as pass_frequency_bins
+	const pass_cumulative *,
+	pass_array *,        // bins out, sized for ((upper - lower) + stride - 1) / stride
+	const int,    // lower bin
+	const int,    // upper bin, excluded
+	const int);   // stride
+
+pass_response  pass_cumulative_execute(pass_cumulative *, const pass_array *);  // power spectrum of either precision
+
+pass_response  pass_cumulative_init(pass_cumulative *, const int);  // bins, the plan's output_rate
+
+double         pass_cumulative_range(  // power of bins lower to upper - 1
+	const pass_cumulative *,
+	const int,    // lower bin
+	const int);   // upper bin, excluded
+
+pass_response  pass_cumulative_term(pass_cumulative *);
+
 pass_response  pass_curl_init();
 
 pass_response  pass_curl_post(
@@ -126,19 +511,158 @@ pass_response  pass_curl_term();
 
 void           pass_decibels(pass_array *, const double, const double);
 
+pass_response  pass_deinterleave(
+	pass_array *,          // sensor_count * channel_count arrays, sensor major
+	const pass_context *,
+	const double *,        // gradient of each array
+	const double *);       // offset of each array
+
 pass_response  pass_endian_swap(pass_context *);
 
 pass_response  pass_fftw_execute(pass_array *, pass_fftw_plan *);
 
-pass_response  pass_fftw_plan_init(pass_fftw_plan *, const int);
+pass_response  pass_fftw_execute_many(
+	pass_array *,          // one per transform, sensor major
+	const pass_context *,
+	pass_fftw_plan *,      // from pass_fftw_plan_init_many
+	const double *,        // gradient of each array
+	const double *);       // offset of each array
+
+pass_response  pass_fftw_plan_bands(  // regenerates the band table, centres from 10 Hz to 200 kHz
+	pass_fftw_plan *,
+	const int);   // fraction, 1 for octaves, 3 for the base ten 1/3 octave bands
+
+pass_response  pass_fftw_plan_init(
+	pass_fftw_plan *,
+	const int,    // sample_rate
+	const int,    // frame_size
+	const int);   // flags, PASS_PLAN_*
+
+pass_response  pass_fftw_plan_init_many(
+	pass_fftw_plan *,
+	const int,    // sample_rate
+	const int,    // frame_size
+	const int,    // transforms, one per sensor and channel
+	const int);   // flags, PASS_PLAN_*
+
+pass_response  pass_fftw_plan_init_pruned(  // double precision transforms, arrays of either precision
+	pass_fftw_plan *,
+	const int,    // sample_rate
+	const int,    // frame_size
+	const double, // lowest frequency needed, in Hz
+	const double, // highest frequency needed, in Hz
+	const int);   // flags, PASS_PLAN_*
 
 pass_response  pass_fftw_plan_term(pass_fftw_plan *);
 
-pass_response  pass_frequency_bins(pass_array *, const int, const int, const int);
-
-pass_response  pass_gaps_detection(pass_context *);
-
-pass_response  pass_octave_bands(pass_array *, const int, const int);
+pass_response  pass_fftw_plan_weighting(  // weights the bands of pass_octave_bands and pass_cumulative_bands
+	pass_fftw_plan *,
+	const int);   // PASS_WEIGHTING_*
+
+pass_response  pass_fftw_threads(const int);    // threads used by plans made after this
+
+pass_response  pass_fftw_wisdom(const char *);  // wisdom file, loaded now and saved after each plan
+
+pass_response  pass_frequency_bins(  // power of each run of stride bins
+	const pass_array *,  // power spectrum
+	pass_array *,        // bins out, sized for ((upper - lower) + stride - 1) / stride
+	const int,    // lower bin
+	const int,    // upper bin, excluded
+	const int);   // stride, bins summed into each
+
+pass_response  pass_gaps_detection(pass_context *);  // one frame per call, again until PASS_FAILURE_NO_DATA after each pass_read
+
+pass_response  pass_iir_bank_execute(
+	pass_iir_bank *,
+	const pass_array *,  // samples, one array per channel, each the same count and at most frame_size
+	pass_array *);       // band mean squares out, one array per channel, sized for upper - lower
+
+pass_response  pass_iir_bank_extremes(  // of the last call, for pass_meter_execute_weighted
+	pass_iir_bank *,
+	const int,     // channel
+	pass_array *,  // mean squares out, sized for upper - lower
+	pass_array *,  // highest time weighted mean squares out
+	pass_array *); // lowest
+
+pass_response  pass_iir_bank_init(
+	pass_iir_bank *,
+	const int,     // sample_rate
+	const int,     // frame_size, the most samples of each channel given to one call
+	const int,     // channels
+	const int,     // lower band number
+	const int,     // upper band number, excluded
+	const double,  // time constant in seconds
+	const int);    // PASS_WEIGHTING_*
+
+pass_response  pass_iir_bank_term(pass_iir_bank *);
+
+pass_response  pass_meter_execute(  // PASS_FAILURE_NO_DATA until an interval is complete
+	pass_meter *,
+	const pass_array *,  // powers, bands or bins
+	const double);       // seconds the powers stand for
+
+pass_response  pass_meter_execute_weighted(  // as pass_meter_execute, for powers time weighted by their source
+	pass_meter *,
+	const pass_array *,  // unweighted powers over the seconds, into Leq
+	const pass_array *,  // highest time weighted powers over the seconds, into Lmax
+	const pass_array *,  // lowest, into Lmin
+	const double);       // seconds the powers stand for
+
+pass_response  pass_meter_init(
+	pass_meter *,
+	const int,      // values per input, at most
+	const double,   // interval in seconds
+	const double);  // time constant in seconds
+
+pass_response  pass_meter_term(pass_meter *);
+
+int            pass_octave_band_number(  // band whose centre is nearest the frequency
+	const int,      // fraction, as pass_fftw_plan_bands
+	const double);  // frequency in Hz
+
+pass_response  pass_octave_bank_execute(  // PASS_FAILURE_NO_DATA until every level has an estimate
+	pass_octave_bank *,
+	const pass_array *,  // samples
+	pass_array *);       // band mean squares out, sized for upper - lower
+
+pass_response  pass_octave_bank_init(
+	pass_octave_bank *,
+	const int,    // sample_rate
+	const int,    // frame_size
+	const int,    // lower band number
+	const int,    // upper band number, excluded as in pass_octave_bands
+	const int);   // PASS_WEIGHTING_*
+
+pass_response  pass_octave_bank_term(pass_octave_bank *);
+
+pass_response  pass_octave_bands(
+	const pass_array *,  // power spectrum
+	pass_array *,        // band powers out, sized for upper - lower
+	const pass_fftw_plan *,
+	const int,    // lower band number
+	const int);   // upper band number
+
+pass_response  pass_pool_init(pass_pool *, const int);  // workers, the caller of pass_pool_run included
+
+pass_response  pass_pool_run(
+	pass_pool *,
+	pass_pool_task,
+	void *,       // user data
+	const int);   // tasks, returns once all of them have run
+
+pass_response  pass_pool_term(pass_pool *);
+
+pass_response  pass_reactor_add(
+	pass_reactor *,
+	pass_context *,        // connected context
+	pass_frame_callback,
+	void *);               // user data, passed to the callback
+
+pass_response  pass_reactor_init(pass_reactor *, const int);  // maximum number of streams
+
+pass_response  pass_reactor_run(pass_reactor *, const int);   // timeout in milliseconds
+
+pass_response  pass_reactor_term(pass_reactor *);
 
 pass_response  pass_read(pass_context *);
 
@@ -157,72 +681,17 @@ pass_response  pass_wav_write(
 
 pass_response  pass_wav_term(pass_wav_description *);
 
-const int octave_band_smallest = 10;
-const int octave_band_largest = 53;
+pass_response  pass_welch_execute(  // PASS_FAILURE_NO_DATA until an estimate is complete
+	pass_welch *,        // only the last estimate completed in the frame is returned
+	pass_array *,        // samples in, averaged power spectrum out
+	pass_fftw_plan *);   // frame_size equal to the segment
 
-const struct {
-	int band_number;
-	int lower;
-	int upper;
+pass_response  pass_welch_init(
+	pass_welch *,
+	const int,   // segment
+	const int,   // hop
+	const int);  // averages
 
-	double lower_weight;
-	double upper_weight;
-} octave_bands[] = {
-	{10,      9,     11, 0.087491, 0.220185},
-	{11,     11,     14, 0.779815, 0.125375},
-	{12,     14,     18, 0.874625, 0.782794},
-	{13,     18,     22, 0.217206, 0.387211},
-	{14,     22,     28, 0.612789, 0.183829},
-	{15,     28,     35, 0.816171, 0.481339},
-	
-	{16,     35,     45, 0.518661, 0.668359},
-	{17,     45,     56, 0.331641, 0.234133},
-	{18,     56,     71, 0.765867, 0.794578},
-	{19,     71,     89, 0.205422, 0.125094},
-	
-	{20,     89,    112, 0.874906, 0.201845},
-	{21,    112,    141, 0.798155, 0.253754},
-	{22,    141,    178, 0.746246, 0.827941},
-	{23,    178,    224, 0.172059, 0.872114},
-	{24,    224,    282, 0.127886, 0.838293},
-
-	{25,    282,    355, 0.161707, 0.813389},
-	{26,    355,    447, 0.186611, 0.683592},
-	{27,    447,    562, 0.316408, 0.341325},
-	{28,    562,    708, 0.658675, 0.945784},
-
-	{29,    708,    891, 0.054216, 0.250938},
-	{30,    891,   1122, 0.749062, 0.018454},
-	{31,   1122,   1413, 0.981546, 0.537545},
-	{32,   1413,   1778, 0.462455, 0.279410},
-
-	{33,   1778,   2239, 0.720590, 0.721139},
-	{34,   2239,   2818, 0.278861, 0.382931},
-	{35,   2818,   3548, 0.617069, 0.133892},
-	{36,   3548,   4467, 0.866108, 0.835922},
-
-	{37,   4467,   5623, 0.164078, 0.413252},
-	{38,   5623,   7079, 0.586748, 0.457844},
-	{39,   7079,   8913, 0.542156, 0.509381},
-	{40,   8913,  11220, 0.490619, 0.184543},
-
-	{41,  11220,  14125, 0.815457, 0.375446},
-	{42,  14125,  17783, 0.624554, 0.794100},
-	{43,  17783,  22387, 0.205900, 0.211386},
-	{44,  22387,  28184, 0.788614, 0.829313},
-
-	{45,  28184,  35481, 0.170687, 0.338923},
-	{46,  35481,  44668, 0.661077, 0.359215},
-	{47,  44668,  56234, 0.640785, 0.132519},
-	{48,  56234,  70795, 0.867481, 0.578438},
-
-	{49,  70795,  89125, 0.421562, 0.093813},
-	{50,  89125, 112202, 0.906187, 0.845430},
-	{51, 112202, 141254, 0.154570, 0.754462},
-	{52, 141254, 177828, 0.245538, 0.941004},
-
-	{53, 177828, 223872, 0.058996, 0.113857}
-};
-const int octave_bands_count = (int)(sizeof(octave_bands) / sizeof(octave_bands[0]));
+pass_response  pass_welch_term(pass_welch *);
 
 #endif
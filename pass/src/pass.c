@@ -1,27 +1,131 @@
 // author john.d.sheehan@ie.ibm.com
 
+#define _GNU_SOURCE
+
 #include <byteswap.h>
 #include <curl/curl.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <json-c/json.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
+#include <linux/io_uring.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PASS_X86
+#endif
+
 #include "macros.h"
 #include "pass.h"
 
+/* after fftw3.h, which would otherwise take fftw_complex to be a C99 complex */
+#include <complex.h>
+
 #define   likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
 const int DATESIZE = 26;
 
+/* set by pass_fftw_wisdom, single precision wisdom goes to the same path with WISDOM_SINGLE appended */
+static char *wisdom_path = NULL;
+
+#define WISDOM_SINGLE  ".f32"
+
+#define URING_ENTRIES  8
+#define URING_SLICES   16   /* provided buffers the ring is cut into, power of two */
+
+#define URING_RECV     1    /* user_data of the multishot receive */
+#define URING_CANCEL   2
+
+#ifndef IORING_CQE_F_BUF_MORE
+#define IORING_CQE_F_BUF_MORE (1U << 4)
+#endif
+
+/* IORING_REGISTER_PBUF_RING argument, older uapi headers call flags pad */
+struct uring_buf_reg {
+	uint64_t  ring_addr;
+	uint32_t  ring_entries;
+	uint16_t  bgid;
+	uint16_t  flags;
+	uint64_t  resv[3];
+};
+
+#define URING_PBUF_RING_INC 2   /* buffers consumed incrementally, 6.12 onwards */
+
+#define DATAGRAM_BATCH  64   /* fragments read by one recvmmsg() */
+#define DATAGRAM_LATE   16   /* frames behind before a sequence counts as an emitter restart */
+
+struct pass_datagram {
+	bool started;
+	uint32_t sequence;          /* frame being reassembled */
+
+	int fragments_total;        /* per frame */
+	int fragments_received;     /* of the frame being reassembled */
+	unsigned char *fragments;   /* per fragment, non zero once received */
+
+	int pending_start;          /* first datagram of the last batch not looked at yet */
+	int pending_count;
+
+	unsigned char *batch;
+	struct iovec iov[DATAGRAM_BATCH];
+	struct mmsghdr messages[DATAGRAM_BATCH];
+};
+
+struct pass_shm {
+	pass_shm_header *header;
+	size_t size;
+
+	unsigned char *slots;
+	uint64_t cursor;   /* next frame to read */
+};
+
+struct pass_uring {
+	int fd;
+	bool armed;   /* multishot receive outstanding */
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	void *cq_ring;
+	size_t sq_ring_size;
+	size_t cq_ring_size;
+	size_t sqes_size;
+
+	struct io_uring_buf_ring *buffers;
+	size_t buffers_size;
+	unsigned short buffers_tail;
+
+	int slice_size;
+	uint64_t written;    /* bytes the kernel put in the ring */
+	uint64_t provided;   /* bytes of the ring handed to the kernel */
+};
+
 struct wav_header {
 	char      chunkID[4];
 	uint32_t  chunkSize;
@@ -44,6 +148,64 @@ struct data_header {
 	uint32_t  chunkSize;
 };
 
+static unsigned planner_flags(const int flags) {
+	if (flags & PASS_PLAN_PATIENT)
+		return FFTW_PATIENT;
+	if (flags & PASS_PLAN_MEASURE)
+		return FFTW_MEASURE;
+
+	return FFTW_ESTIMATE;
+}
+
+/* written next to the wisdom file and renamed over it, other processes may be reading it */
+static void wisdom_save(bool single) {
+	if (wisdom_path == NULL)
+		return;
+
+	char path[PATH_MAX];
+	char temporary[PATH_MAX + 16];
+	snprintf(path, sizeof(path), "%s%s", wisdom_path, single ? WISDOM_SINGLE : "");
+	snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)(getpid()));
+
+	int saved = single ?
+		fftwf_export_wisdom_to_filename(temporary) :
+		fftw_export_wisdom_to_filename(temporary);
+
+	if ((saved == 0) || (rename(temporary, path) != 0)) {
+		info(stdout, "failed to save wisdom to %s", path);
+		unlink(temporary);
+	}
+}
+
+/* power of transform t of the plan into the array */
+static void power_spectrum(pass_array *array, const pass_fftw_plan *plan, const int t) {
+	if (plan->flags & PASS_PLAN_SINGLE) {
+		const fftwf_complex *result = plan->result_f + ((size_t)(t) * plan->output_rate);
+		float *values = array->values_f;
+
+		values[0] = result[0][0] * result[0][0];
+		for (int i = 1; i < plan->output_rate; i++) {
+			values[i] = 2.0f * (result[i][0] * result[i][0] + result[i][1] * result[i][1]);
+		}
+		array->count = plan->output_rate;
+
+		return;
+	}
+
+	const fftw_complex *result = plan->result + ((size_t)(t) * plan->output_rate);
+	double *values = array->values;
+
+	values[0] = result[0][0] * result[0][0];
+	for (int i = 1; i < plan->output_rate; i++) {
+		values[i] = 2.0 * (result[i][0] * result[i][0] + result[i][1] * result[i][1]);
+	}
+	array->count = plan->output_rate;
+}
+
+/*
+ * Scaled by 1 / sqrt(N * sum(w^2)), so the one sided powers of a transform sum
+ * to the mean square of the frame and band powers do not depend on its length.
+ */
 static void hann(double *buffer, const int window_length) {
 	int i;
 
@@ -62,13 +224,376 @@ static void hann(double *buffer, const int window_length) {
 		s += (buffer[i] * buffer[i]);
 	}
 
+	s = sqrt(window_length * s);
 	for (i = 0; i < window_length; ++i) {
 		buffer[i] /= s;
 	}
 }
 
-static int header_search(const unsigned char *buffer, int start, int end) {
-	while (start < end - PASS_DATA_HEADER_SIZE) {
+/*
+ * Base ten 1/b octave bands, IEC 61260: the octave ratio is 10^0.3 and band n
+ * is centred on 10^((3n + d) / 10b) Hz, d being 1.5 for even b and 0 for odd,
+ * so 1/3 octave band n sits at 10^(n / 10) Hz and the 1 kHz band is 10b. The
+ * edges are half a band either side, side -1 for the lower and 1 for the upper,
+ * side 0 is the centre.
+ */
+static double octave_band_edge(const int fraction, const int n, const int side) {
+	double d = ((fraction % 2) == 0) ? 1.5 : 0.0;
+
+	return pow(10.0, ((3.0 * n) + d + (1.5 * side)) / (10.0 * fraction));
+}
+
+/*
+ * Bin k stands for the unit step from k to k + 1. Each edge lands on the bin
+ * whose step holds it, weighted by the fraction of that step inside the band.
+ * The table the library used to hard-code rounded the edges to their nearest
+ * bin instead, edges past the middle of a step counted or dropped a whole bin.
+ */
+static void octave_bands_generate(pass_octave_band *bands, const int fraction, const int smallest, const int count, const double bin_width) {
+	for (int i = 0; i < count; i++) {
+		int n = smallest + i;
+
+		double lower = octave_band_edge(fraction, n, -1) / bin_width;
+		double upper = octave_band_edge(fraction, n, 1) / bin_width;
+
+		bands[i].lower = (int)floor(lower);
+		bands[i].upper = (int)floor(upper);
+
+		if (bands[i].lower == bands[i].upper) {
+			/* the band fits inside one step, weight a single bin */
+			bands[i].lower_weight = upper - lower;
+			bands[i].upper_weight = 0.0;
+		} else {
+			bands[i].lower_weight = (bands[i].lower + 1) - lower;
+			bands[i].upper_weight = upper - bands[i].upper;
+		}
+	}
+}
+
+/*
+ * Power gain of the IEC 61672 A and C weightings, from their analytic forms
+ * with the 2.00 and 0.06 dB that put 1 kHz at 0 dB.
+ */
+static double weighting_gain(const int weighting, const double frequency) {
+	double f2 = frequency * frequency;
+	double r;
+
+	switch (weighting) {
+		case PASS_WEIGHTING_A:
+			r = (148693636.0 * f2 * f2) / ((f2 + 424.36) * sqrt((f2 + 11599.29) * (f2 + 544496.41)) * (f2 + 148693636.0));
+			return r * r * pow(10.0, 2.00 / 10.0);
+
+		case PASS_WEIGHTING_C:
+			r = (148693636.0 * f2) / ((f2 + 424.36) * (f2 + 148693636.0));
+			return r * r * pow(10.0, 0.06 / 10.0);
+
+		default:
+			return 1.0;
+	}
+}
+
+/* weights of count bands from smallest, at their exact centres */
+static void octave_weights_generate(double *weights, const int weighting, const int fraction, const int smallest, const int count) {
+	for (int i = 0; i < count; i++)
+		weights[i] = weighting_gain(weighting, octave_band_edge(fraction, smallest + i, 0));
+}
+
+/* power of bins lower to upper - 1, the carries put back what the sums rounded off */
+static double cumulative_between(const pass_cumulative *cumulative, const int lower, const int upper) {
+	return (cumulative->sum[upper] - cumulative->sum[lower]) + (cumulative->carry[upper] - cumulative->carry[lower]);
+}
+
+/*
+ * Pruned spectra. Decimation is a cascade of Kaiser windowed halfband filters,
+ * each stage only as long as the band left above the needed bins allows. The
+ * cost model counts flops, 2.5 n log2 n for a real transform.
+ */
+#define PRUNE_ATTENUATION  100.0   /* dB of stopband, aliases end up below the Hann sidelobes */
+#define PRUNE_TRANSITION   0.1     /* narrowest transition, fraction of the stage's input rate */
+#define PRUNE_MARGIN       4       /* bins past the last needed one kept in the passband, Hann leaks two */
+
+/* octave bank levels keep their bands below this fraction of the level's rate */
+#define BANK_PASSBAND  0.375
+#define BANK_BINS      8     /* bins across the narrowest band of a level, at least */
+#define BANK_SEGMENT   16    /* shortest transform */
+
+/* iir bank levels keep their bands below this fraction of the level's rate, clear of the bilinear warping */
+#define IIR_PASSBAND  0.25
+#define IIR_BLOCK     256   /* samples of each channel taken through all levels at a time, the levels stay in cache */
+
+static double fft_cost(const int n) {
+	return 2.5 * n * log2((double)(n));
+}
+
+static double bessel_i0(const double x) {
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 64; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-17)
+			break;
+	}
+
+	return sum;
+}
+
+/* odd coefficients of a halfband lowpass with the given transition */
+static int halfband_count(const double transition) {
+	int half = (int)(ceil((PRUNE_ATTENUATION - 8.0) / (2.285 * 2.0 * M_PI * transition) / 2.0));
+
+	return (half + 1) / 2;
+}
+
+/* halfband_count coefficients, normalised to unit gain at DC */
+static int halfband_design(double *odd, const double transition) {
+	double beta = 0.1102 * (PRUNE_ATTENUATION - 8.7);
+	int count = halfband_count(transition);
+	int half = (2 * count) - 1;
+
+	double sum = 0.0;
+	for (int i = 0; i < count; i++) {
+		int j = (2 * i) + 1;
+		double r = (double)(j) / (double)(half + 1);
+		double w = bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+
+		odd[i] = ((i % 2) == 0 ? 1.0 : -1.0) / (M_PI * j) * w;
+		sum += odd[i];
+	}
+
+	for (int i = 0; i < count; i++)
+		odd[i] *= 0.25 / sum;
+
+	return count;
+}
+
+/* count samples of in down to count / 2, zero outside the frame */
+static void decimate_by_two(double *out, const double *in, const int count, const double *odd, const int odd_count) {
+	int reach = (2 * odd_count) - 1;
+
+	for (int m = 0; m < count / 2; m++) {
+		int n = 2 * m;
+		double sum = 0.5 * in[n];
+
+		if ((n - reach >= 0) && (n + reach < count)) {
+			for (int i = 0; i < odd_count; i++) {
+				int j = (2 * i) + 1;
+				sum += odd[i] * (in[n - j] + in[n + j]);
+			}
+		} else {
+			for (int i = 0; i < odd_count; i++) {
+				int j = (2 * i) + 1;
+				double a = (n - j >= 0) ? in[n - j] : 0.0;
+				double b = (n + j < count) ? in[n + j] : 0.0;
+				sum += odd[i] * (a + b);
+			}
+		}
+
+		out[m] = sum;
+	}
+}
+
+/* decimate_by_two across frames, the first output is centred on the first sample seen, channels interleaved */
+static int halfband_stream(const double *halfband, const int halfband_count, const int channels, double *history, int *history_count, const double *in, const int count, double *out) {
+	int reach = (2 * halfband_count) - 1;
+	double *h = history;
+
+	memcpy(h + (*history_count * channels), in, sizeof(double) * count * channels);
+	int total = *history_count + count;
+
+	int m = 0;
+	int c = reach;
+	for (; c + reach < total; c += 2) {
+		double *restrict o = out + (m * channels);
+		const double *centre = h + (c * channels);
+
+		for (int k = 0; k < channels; k++)
+			o[k] = 0.5 * centre[k];
+
+		for (int i = 0; i < halfband_count; i++) {
+			int j = ((2 * i) + 1) * channels;
+			const double *before = centre - j;
+			const double *after = centre + j;
+
+			for (int k = 0; k < channels; k++)
+				o[k] += halfband[i] * (before[k] + after[k]);
+		}
+		m++;
+	}
+
+	/* keep what the next centre reaches back to */
+	int shift = c - reach;
+	memmove(h, h + (shift * channels), sizeof(double) * (total - shift) * channels);
+	*history_count = total - shift;
+
+	return m;
+}
+
+/*
+ * Sixth order Butterworth bandpass from lower to upper Hz as three biquads,
+ * bilinear with both edges prewarped. Each analog lowpass pole p becomes the
+ * pair p w / 2 +- sqrt((p w / 2)^2 - w0^2), w the bandwidth and w0 the centre.
+ * A section takes one pole of each conjugate pair, zeros at z = 1 and z = -1,
+ * and unit gain at the centre, where the whole bandpass has unit gain.
+ */
+static void iir_band_design(double *gain, double *a1, double *a2, const int stride, const double sample_rate, const double lower, const double upper) {
+	double fs2 = 2.0 * sample_rate;
+	double w1 = fs2 * tan(M_PI * lower / sample_rate);
+	double w2 = fs2 * tan(M_PI * upper / sample_rate);
+	double w0 = sqrt(w1 * w2);
+
+	double complex e1 = cexp(-I * 2.0 * atan(w0 / fs2));
+	double complex e2 = e1 * e1;
+
+	int s = 0;
+	for (int k = 0; k < PASS_IIR_SECTIONS; k++) {
+		double complex p = cexp(I * M_PI * ((2.0 * k) + PASS_IIR_SECTIONS + 1.0) / (2.0 * PASS_IIR_SECTIONS));
+		double complex h = p * (w2 - w1) / 2.0;
+		double complex root = csqrt((h * h) - (w0 * w0));
+		double complex poles[2] = { h + root, h - root };
+
+		for (int j = 0; j < 2; j++) {
+			double complex z = (fs2 + poles[j]) / (fs2 - poles[j]);
+			if ((cimag(z) <= 0.0) || (s == PASS_IIR_SECTIONS))
+				continue;
+
+			a1[s * stride] = -2.0 * creal(z);
+			a2[s * stride] = creal(z * conj(z));
+			gain[s * stride] = cabs(1.0 + (a1[s * stride] * e1) + (a2[s * stride] * e2)) / cabs(1.0 - e2);
+			s++;
+		}
+	}
+}
+
+/* the level's samples through its bands, every channel in each loop, into the sums of squares and the running levels with their extremes */
+static void iir_level_run(pass_iir_level *level, const int channels, double *restrict values, double *restrict highest, double *restrict lowest) {
+	int width = (level->upper - level->lower) * channels;
+	double *restrict y = level->output;
+	double *restrict squares = level->squares;
+
+	for (int i = 0; i < level->count; i++) {
+		const double *x = level->samples + (i * channels);
+
+		for (int j = 0; j < width; j += channels) {
+			for (int k = 0; k < channels; k++)
+				y[j + k] = x[k];
+		}
+
+		for (int s = 0; s < PASS_IIR_SECTIONS; s++) {
+			const double *restrict g = level->gain + (s * width);
+			const double *restrict a1 = level->a1 + (s * width);
+			const double *restrict a2 = level->a2 + (s * width);
+			double *restrict z1 = level->z1 + (s * width);
+			double *restrict z2 = level->z2 + (s * width);
+
+			for (int j = 0; j < width; j++) {
+				double in = y[j];
+				double out = (g[j] * in) + z1[j];
+				z1[j] = z2[j] - (a1[j] * out);
+				z2[j] = -(g[j] * in) - (a2[j] * out);
+				y[j] = out;
+			}
+		}
+
+		for (int j = 0; j < width; j++)
+			squares[j] += y[j] * y[j];
+
+		if (level->weight > 0.0) {
+			for (int j = 0; j < width; j++) {
+				values[j] += level->weight * ((y[j] * y[j]) - values[j]);
+				highest[j] = (values[j] > highest[j]) ? values[j] : highest[j];
+				lowest[j] = (values[j] < lowest[j]) ? values[j] : lowest[j];
+			}
+		}
+	}
+	level->squared += level->count;
+}
+
+static void goertzel(double *values, const double *windowed, const int count, const int lower, const int upper) {
+	for (int k = lower; k <= upper; k++) {
+		double w = (2.0 * M_PI * k) / count;
+		double c = 2.0 * cos(w);
+		double s1 = 0.0;
+		double s2 = 0.0;
+
+		for (int n = 0; n < count; n++) {
+			double s0 = windowed[n] + c * s1 - s2;
+			s2 = s1;
+			s1 = s0;
+		}
+
+		double re = s1 - s2 * cos(w);
+		double im = s2 * sin(w);
+		values[k] = ((k == 0) ? 1.0 : 2.0) * (re * re + im * im);
+	}
+}
+
+/* power of bins lower to upper into values, from the windowed frame */
+static void spectrum_pruned(double *values, pass_fftw_plan *plan) {
+	if (plan->engine == PASS_ENGINE_GOERTZEL) {
+		goertzel(values, plan->windowed, plan->frame_size, plan->lower, plan->upper);
+		return;
+	}
+
+	const double *in = plan->windowed;
+	int count = plan->frame_size;
+
+	if (plan->stages == 0)
+		memcpy(plan->input, in, sizeof(double) * count);
+
+	for (int s = 0; s < plan->stages; s++) {
+		double *out;
+		if (s == plan->stages - 1)
+			out = plan->input;
+		else
+			out = plan->decimated + (((s % 2) == 0) ? 0 : plan->frame_size / 2);
+
+		decimate_by_two(out, in, count, plan->halfband[s], plan->halfband_count[s]);
+
+		in = out;
+		count /= 2;
+	}
+
+	fftw_execute(plan->plan_forward);
+
+	/* each decimation halves the sum, the bins keep their width */
+	double scale = (double)(plan->frame_size) / (double)(plan->transform_size);
+	scale *= scale;
+
+	const fftw_complex *result = plan->result;
+	for (int k = plan->lower; k <= plan->upper; k++) {
+		values[k] = ((k == 0) ? 1.0 : 2.0) * scale * (result[k][0] * result[k][0] + result[k][1] * result[k][1]);
+	}
+}
+
+/*
+ * The same bands with bin k spanning k - 0.5 to k + 0.5. Levels of an octave
+ * bank have different bin widths, only centred bins split a tone on the edge
+ * between two levels the way a single transform would.
+ */
+static void octave_bands_centred(pass_octave_band *bands, const int fraction, const int smallest, const int count, const double bin_width) {
+	for (int i = 0; i < count; i++) {
+		int n = smallest + i;
+
+		double lower = octave_band_edge(fraction, n, -1) / bin_width;
+		double upper = octave_band_edge(fraction, n, 1) / bin_width;
+
+		bands[i].lower = (int)(floor(lower + 0.5));
+		bands[i].upper = (int)(floor(upper + 0.5));
+
+		if (bands[i].lower == bands[i].upper) {
+			bands[i].lower_weight = upper - lower;
+			bands[i].upper_weight = 0.0;
+		} else {
+			bands[i].lower_weight = (bands[i].lower + 0.5) - lower;
+			bands[i].upper_weight = upper - (bands[i].upper - 0.5);
+		}
+	}
+}
+
+static int header_search_scalar(const unsigned char *buffer, int start, int end) {
+	while (start <= end - PASS_DATA_HEADER_SIZE) {
 		if (IS_PASS_DATA_HEADER(buffer + start))
 			return start;
 		start++;
@@ -76,505 +601,3204 @@ static int header_search(const unsigned char *buffer, int start, int end) {
 	return end;
 }
 
-pass_response pass_array_allocate(pass_array *array, const int total) {
-	array->values = malloc(sizeof(double) * total);
-	return_failure_if((array->values == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+/*
+ * The vector scanners compare 64 bytes at a time against 0xc0 and reduce the
+ * byte mask to the positions that start a run of eight 0xc0 bytes. Only those
+ * candidates are checked with IS_PASS_DATA_HEADER, so the offsets returned are
+ * the same as header_search_scalar. A block yields candidates for its first 56
+ * positions, the last 8 are covered again by the next block.
+ */
+static inline int header_search_candidates(const unsigned char *buffer, int start, int end, uint64_t mask) {
+	mask &= mask >> 1;
+	mask &= mask >> 2;
+	mask &= mask >> 4;
+	mask &= 0x00ffffffffffffffULL;
+
+	while (mask) {
+		int position = start + __builtin_ctzll(mask);
+		if (position > end - PASS_DATA_HEADER_SIZE)
+			return end;
+		if (IS_PASS_DATA_HEADER(buffer + position))
+			return position;
+		mask &= mask - 1;
+	}
+	return -1;
+}
 
-	array->count = 0;
-	array->total = total;
+#ifdef PASS_X86
+__attribute__((target("sse2")))
+static int header_search_sse2(const unsigned char *buffer, int start, int end) {
+	const __m128i magic = _mm_set1_epi8((char)0xc0);
+
+	while (start + 64 <= end) {
+		const __m128i *b = (const __m128i *)(buffer + start);
+		uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(b + 0), magic));
+		uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(b + 1), magic));
+		uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(b + 2), magic));
+		uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(b + 3), magic));
+
+		uint64_t mask = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+		if (mask) {
+			int found = header_search_candidates(buffer, start, end, mask);
+			if (found >= 0)
+				return found;
+		}
+		start += 56;
+	}
+	return header_search_scalar(buffer, start, end);
+}
 
-	return PASS_SUCCESS;
+__attribute__((target("avx2")))
+static int header_search_avx2(const unsigned char *buffer, int start, int end) {
+	const __m256i magic = _mm256_set1_epi8((char)0xc0);
+
+	while (start + 64 <= end) {
+		const __m256i *b = (const __m256i *)(buffer + start);
+		uint64_t m0 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(b + 0), magic));
+		uint64_t m1 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(b + 1), magic));
+
+		uint64_t mask = m0 | (m1 << 32);
+		if (mask) {
+			int found = header_search_candidates(buffer, start, end, mask);
+			if (found >= 0)
+				return found;
+		}
+		start += 56;
+	}
+	return header_search_scalar(buffer, start, end);
 }
 
-pass_response pass_array_free(pass_array *array) {
-	if (array->values != NULL) {
-		free(array->values);
-		array->values = NULL;
+__attribute__((target("avx512f,avx512bw")))
+static int header_search_avx512(const unsigned char *buffer, int start, int end) {
+	const __m512i magic = _mm512_set1_epi8((char)0xc0);
+
+	while (start + 64 <= end) {
+		uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(buffer + start), magic);
+		if (mask) {
+			int found = header_search_candidates(buffer, start, end, mask);
+			if (found >= 0)
+				return found;
+		}
+		start += 56;
 	}
+	return header_search_scalar(buffer, start, end);
+}
+#endif
 
-	array->count = 0;
-	array->total = 0;
+static int header_search(const unsigned char *buffer, int start, int end) {
+	static int (*search)(const unsigned char *, int, int) = NULL;
+
+	if (unlikely(search == NULL)) {
+		search = header_search_scalar;
+#ifdef PASS_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512bw"))
+			search = header_search_avx512;
+		else if (__builtin_cpu_supports("avx2"))
+			search = header_search_avx2;
+		else if (__builtin_cpu_supports("sse2"))
+			search = header_search_sse2;
+#endif
+	}
 
-	return PASS_SUCCESS;
+	return search(buffer, start, end);
 }
 
-void pass_close(pass_context *pc) {
-	if (pc->sd >= 0)
-		close(pc->sd);
-	pc->sd = -1;
+/*
+ * The emitters put a 16 bit sum of the byte swapped even numbered samples
+ * of the payload in the header. Vector versions swap with two shifts, clear
+ * the odd samples and let the 16 bit lanes wrap, which is the same sum.
+ */
+static uint16_t checksum_scalar(const short *payload, int start, int count) {
+	uint16_t total = 0;
+
+	for (int i = start; i < count; i += 2)
+		total += bswap_16((uint16_t)payload[i]);
+
+	return total;
 }
 
-pass_response pass_connect(pass_context *pc, const char *server, const char *port) {
-	int rc;
-	int sd;
+#ifdef PASS_X86
+static uint16_t checksum_sse2(const short *payload, int count) {
+	const __m128i even = _mm_set1_epi32(0x0000ffff);
+	__m128i acc = _mm_setzero_si128();
 
-	debug(stdout, "configuring remote address");
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(payload + i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		acc = _mm_add_epi16(acc, _mm_and_si128(v, even));
+	}
 
-	struct addrinfo hints;
-	memset(&hints, '\0', sizeof(hints));
-	hints.ai_socktype = SOCK_STREAM;
+	uint16_t lanes[8];
+	_mm_storeu_si128((__m128i *)lanes, acc);
 
-	struct addrinfo *peer_address;
-	rc = getaddrinfo(server, port, &hints, &peer_address);
-	return_failure_if((rc != 0), PASS_FAILURE_NO_CONN, "getaddrinfo() failed: %s", strerror(errno));
+	uint16_t total = checksum_scalar(payload, i, count);
+	for (int l = 0; l < 8; l++)
+		total += lanes[l];
 
-	char address_buffer[128];
-	char service_buffer[128];
-	getnameinfo(
-		peer_address->ai_addr,
-		peer_address->ai_addrlen,
-		address_buffer,
-		sizeof(address_buffer),
-		service_buffer,
-		sizeof(service_buffer),
-		NI_NUMERICHOST);
-	info(stdout, "server address: %s %s", address_buffer, service_buffer);
+	return total;
+}
 
-	debug(stdout, "creating socket");
+__attribute__((target("avx2")))
+static uint16_t checksum_avx2(const short *payload, int count) {
+	const __m256i even = _mm256_set1_epi32(0x0000ffff);
+	__m256i acc = _mm256_setzero_si256();
 
-	sd = socket(
-		peer_address->ai_family,
-		peer_address->ai_socktype,
-		peer_address->ai_protocol);
-	return_failure_if((sd < 0), PASS_FAILURE_NO_CONN, "socket() failed: %s", strerror(errno));
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(payload + i));
+		v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+		acc = _mm256_add_epi16(acc, _mm256_and_si256(v, even));
+	}
 
-	debug(stdout, "connecting");
+	uint16_t lanes[16];
+	_mm256_storeu_si256((__m256i *)lanes, acc);
 
-	rc = connect(
-		sd,
-		peer_address->ai_addr,
-		peer_address->ai_addrlen);
-	return_failure_if((rc != 0), PASS_FAILURE_NO_CONN, "connect() failed: %s", strerror(errno));
+	uint16_t total = checksum_scalar(payload, i, count);
+	for (int l = 0; l < 16; l++)
+		total += lanes[l];
 
-	freeaddrinfo(peer_address);
+	return total;
+}
+#endif
+
+static uint16_t checksum(const short *payload, int count) {
+#ifdef PASS_X86
+	static uint16_t (*sum)(const short *, int) = NULL;
+
+	if (unlikely(sum == NULL)) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			sum = checksum_avx2;
+		else
+			sum = checksum_sse2;
+	}
 
-	pc->sd = sd;
+	return sum(payload, count);
+#else
+	return checksum_scalar(payload, 0, count);
+#endif
+}
 
-	debug(stdout, "connected");
+/*
+ * Splits the interleaved payload into one array per sensor and channel. The
+ * frame is walked in blocks of rows small enough to stay in L1 while every
+ * channel is pulled out of them, so the payload is read from memory once.
+ * Big endian samples are swapped on the way through rather than in place.
+ * out holds float arrays when single is set, double arrays otherwise, and
+ * window, when given, is of the same type and multiplies every array.
+ */
+#define DEINTERLEAVE_ROWS  256
 
-	return PASS_SUCCESS;
+static inline short sample_get(const short *payload, int index, bool swap) {
+	short s = payload[index];
+
+	return swap ? (short)bswap_16((uint16_t)s) : s;
 }
 
-pass_response pass_context_free(pass_context *pc) {
-	pc->sequence_id = 0;
+static void deinterleave_scalar(
+	void **out, const short *payload, int stride, int start, int end, bool swap, bool single,
+	const double *gradient, const double *offset, const void *window) {
+
+	for (int c = 0; c < stride; c++) {
+		if (single) {
+			float *values = out[c];
+			const float *w = window;
+			float g = (float)(gradient[c]);
+			float o = (float)(offset[c]);
+
+			for (int i = start; i < end; i++) {
+				values[i] = ((float)(sample_get(payload, (i * stride) + c, swap))) * g + o;
+				if (w != NULL)
+					values[i] *= w[i];
+			}
+		} else {
+			double *values = out[c];
+			const double *w = window;
 
-	pc->sensor_count  = 0;
-	pc->channel_count = 0;
-	pc->sample_rate   = 0;
-	pc->header_size   = 0;
+			for (int i = start; i < end; i++) {
+				values[i] = ((double)(sample_get(payload, (i * stride) + c, swap))) * gradient[c] + offset[c];
+				if (w != NULL)
+					values[i] *= w[i];
+			}
+		}
+	}
+}
+
+static void deinterleave_blocked(
+	void **out, const short *payload, int stride, int rows, bool swap, bool single,
+	const double *gradient, const double *offset, const void *window) {
+
+	for (int b = 0; b < rows; b += DEINTERLEAVE_ROWS) {
+		int end = (b + DEINTERLEAVE_ROWS < rows) ? b + DEINTERLEAVE_ROWS : rows;
+		deinterleave_scalar(out, payload, stride, b, end, swap, single, gradient, offset, window);
+	}
+}
+
+#ifdef PASS_X86
+/*
+ * Gathers 8 rows of a channel as dwords with the sample in the low half, a
+ * byte shuffle moves it, swapped or not, to the high half for sign extension.
+ */
+__attribute__((target("avx2")))
+static void deinterleave_avx2(
+	void **out, const short *payload, int stride, int rows, bool swap, bool single,
+	const double *gradient, const double *offset, const void *window) {
+
+	const __m256i step = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	const __m256i high = swap ?
+		_mm256_setr_epi8(
+			-1, -1, 1, 0, -1, -1, 5, 4, -1, -1, 9, 8, -1, -1, 13, 12,
+			-1, -1, 1, 0, -1, -1, 5, 4, -1, -1, 9, 8, -1, -1, 13, 12) :
+		_mm256_setr_epi8(
+			-1, -1, 0, 1, -1, -1, 4, 5, -1, -1, 8, 9, -1, -1, 12, 13,
+			-1, -1, 0, 1, -1, -1, 4, 5, -1, -1, 8, 9, -1, -1, 12, 13);
+	const __m128i pairs = swap ?
+		_mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14) :
+		_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	/* the last row is left to the scalar loop, its gather would read past the payload */
+	int vector_rows = ((rows - 1) / 8) * 8;
+	if (vector_rows < 0)
+		vector_rows = 0;
+
+	for (int b = 0; b < vector_rows; b += DEINTERLEAVE_ROWS) {
+		int end = (b + DEINTERLEAVE_ROWS < vector_rows) ? b + DEINTERLEAVE_ROWS : vector_rows;
+
+		for (int c = 0; c < stride; c++) {
+			const __m256d g = _mm256_set1_pd(gradient[c]);
+			const __m256d o = _mm256_set1_pd(offset[c]);
+			const __m256 gf = _mm256_set1_ps((float)(gradient[c]));
+			const __m256 of = _mm256_set1_ps((float)(offset[c]));
+
+			for (int i = b; i < end; i += 8) {
+				__m256i v;
+				if (stride == 1) {
+					__m128i s = _mm_loadu_si128((const __m128i *)(payload + i));
+					v = _mm256_cvtepi16_epi32(_mm_shuffle_epi8(s, pairs));
+				} else {
+					__m256i index = _mm256_add_epi32(step, _mm256_set1_epi32((i * stride) + c));
+					v = _mm256_i32gather_epi32((const int *)payload, index, 2);
+					v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, high), 16);
+				}
+
+				if (single) {
+					float *values = out[c];
+					__m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(v), gf), of);
+					if (window != NULL)
+						f = _mm256_mul_ps(f, _mm256_loadu_ps((const float *)(window) + i));
+
+					_mm256_storeu_ps(values + i, f);
+				} else {
+					double *values = out[c];
+					__m256d lo = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), g), o);
+					__m256d hi = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), g), o);
+					if (window != NULL) {
+						lo = _mm256_mul_pd(lo, _mm256_loadu_pd((const double *)(window) + i));
+						hi = _mm256_mul_pd(hi, _mm256_loadu_pd((const double *)(window) + i + 4));
+					}
+
+					_mm256_storeu_pd(values + i, lo);
+					_mm256_storeu_pd(values + i + 4, hi);
+				}
+			}
+		}
+	}
+
+	deinterleave_scalar(out, payload, stride, vector_rows, rows, swap, single, gradient, offset, window);
+}
+#endif
+
+static void deinterleave(
+	void **out, const short *payload, int stride, int rows, bool swap, bool single,
+	const double *gradient, const double *offset, const void *window) {
+
+#ifdef PASS_X86
+	static void (*split)(void **, const short *, int, int, bool, bool, const double *, const double *, const void *) = NULL;
+
+	if (unlikely(split == NULL)) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			split = deinterleave_avx2;
+		else
+			split = deinterleave_blocked;
+	}
+
+	split(out, payload, stride, rows, swap, single, gradient, offset, window);
+#else
+	deinterleave_blocked(out, payload, stride, rows, swap, single, gradient, offset, window);
+#endif
+}
+
+/* bytes of samples in one frame, all sensors and channels */
+static inline int payload_size(const pass_context *pc) {
+	return sizeof(short) * pc->sensor_count * pc->channel_count * pc->frame_size;
+}
+
+static inline bool header_is_v2(const unsigned char *h) {
+	uint64_t version;
+	memcpy(&version, h + offsetof(pass_header, version), sizeof(version));
+
+	return version == PASS_HEADER_VERSION_2;
+}
+
+/* a v2 header describes the frames this context was set up for */
+static bool header_v2_matches(const pass_context *pc, const unsigned char *h) {
+	pass_header header;
+	memcpy(&header, h, sizeof(header));
+
+	/* the counts are a byte each, larger contexts only take v1 frames */
+	if ((pc->sensor_count > UINT8_MAX) || (pc->channel_count > UINT8_MAX))
+		return false;
+
+	return ((int)(header.length) == payload_size(pc)) &&
+	       (header.format == PASS_FORMAT_INT16) &&
+	       (header.sensors == pc->sensor_count) &&
+	       (header.channels == pc->channel_count);
+}
+
+static int read_vector(int sd, struct iovec *iov, int iovcnt) {
+	int count = 0;
+
+	while (iovcnt > 0) {
+		ssize_t received = readv(sd, iov, iovcnt);
+		if (received <= 0)
+			return -1;
+
+		count += received;
+		while ((iovcnt > 0) && ((size_t)received >= iov->iov_len)) {
+			received -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (unsigned char *)(iov->iov_base) + received;
+			iov->iov_len -= received;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * The ring is backed by a memfd mapped twice, back to back, so any run of up
+ * to total bytes starting inside the first mapping is contiguous in memory.
+ * Headers and payloads are handed out as pointers into it, nothing is shifted.
+ */
+static pass_response ring_allocate(pass_ring *ring, const int size) {
+	int rc;
+
+	long page_size = sysconf(_SC_PAGESIZE);
+	int total = (int)(((size + page_size - 1) / page_size) * page_size);
+
+	int fd = memfd_create("pass_ring", MFD_CLOEXEC);
+	return_failure_if((fd < 0), PASS_FAILURE_NOMEM, "memfd_create() failed: %s", strerror(errno));
+
+	rc = ftruncate(fd, total);
+	if (rc != 0) {
+		close(fd);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "ftruncate() failed: %s", strerror(errno));
+	}
+
+	unsigned char *base = mmap(NULL, 2 * (size_t)total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "mmap() failed: %s", strerror(errno));
+	}
+
+	void *lower = mmap(base, total, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	void *upper = mmap(base + total, total, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	close(fd);
+
+	if ((lower == MAP_FAILED) || (upper == MAP_FAILED)) {
+		munmap(base, 2 * (size_t)total);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "mmap() failed: %s", strerror(errno));
+	}
+
+	ring->start = 0;
+	ring->count = 0;
+	ring->total = total;
+	ring->overflowed = false;
+	ring->buffer = base;
+
+	return PASS_SUCCESS;
+}
+
+static void ring_consume(pass_ring *ring, const int count) {
+	ring->start = (ring->start + count) % ring->total;
+	ring->count -= count;
+}
+
+/* empties a full ring, frame_next reports the loss as a gap */
+static void ring_discard(pass_ring *ring) {
+	if (ring->count > 0)
+		ring->overflowed = true;
+
+	ring_consume(ring, ring->count);
+}
+
+/* reads whatever the socket has ready into the free part of the ring */
+static int ring_fill(pass_context *pc) {
+	pass_ring *ring = &(pc->ring);
+
+	if (unlikely(ring->count == ring->total)) {
+		/* too much data, emptying buffer */
+		ring_discard(ring);
+	}
+
+	unsigned char *buf = ring->buffer + ring->start + ring->count;
+
+	int received = read(pc->sd, buf, ring->total - ring->count);
+	if (received > 0)
+		ring->count += received;
+
+	return received;
+}
+
+static void ring_free(pass_ring *ring) {
+	if (ring->buffer != NULL)
+		munmap(ring->buffer, 2 * (size_t)ring->total);
+	ring->buffer = NULL;
+
+	ring->start = 0;
+	ring->count = 0;
+	ring->total = 0;
+	ring->overflowed = false;
+}
+
+/*
+ * Takes the oldest complete frame out of the ring. A frame is complete once
+ * its payload is in the ring, the header that follows it is checked when it
+ * has arrived too. Returns PASS_FAILURE_NO_DATA
+ * when more bytes are needed and PASS_FAILURE_GAP_DETECTED when bytes were
+ * dropped to get back in step.
+ */
+static pass_response frame_next(pass_context *pc) {
+	pass_ring *ring = &(pc->ring);
+	unsigned char *data = ring->buffer + ring->start;
+
+	int byte_count = payload_size(pc);
+
+	if (unlikely(ring->overflowed)) {
+		ring->overflowed = false;
+
+		return PASS_FAILURE_GAP_DETECTED;
+	}
+
+	if (pc->header_size == 0) {
+		if (ring->count < byte_count)
+			return PASS_FAILURE_NO_DATA;
+
+		pc->payload = (short *)(data);
+		ring_consume(ring, byte_count);
+
+		return PASS_SUCCESS;
+	}
+
+	if (ring->count < PASS_DATA_HEADER_SIZE) {
+		/* insufficent data to search for a header */
+		return PASS_FAILURE_NO_DATA;
+	}
+
+	/* search for first header, usually right at the start */
+	int header_first_start = IS_PASS_DATA_HEADER(data) ? 0 : header_search(data, 0, ring->count);
+	if (unlikely(header_first_start == ring->count)) {
+		/* first header not found, removing old data but the start of a header */
+		ring_consume(ring, ring->count - (PASS_DATA_HEADER_SIZE - 1));
+
+		return PASS_FAILURE_GAP_DETECTED;
+	}
+
+	if (unlikely(header_first_start > 0)) {
+		/* bytes before the header belong to no frame, dropping them is a gap */
+		ring_consume(ring, header_first_start);
+
+		return PASS_FAILURE_GAP_DETECTED;
+	}
+
+	int header_first_end = header_first_start + PASS_DATA_HEADER_SIZE;
+	int header_second_start = header_first_end + byte_count;
+
+	bool v2 = header_is_v2(data + header_first_start);
+	if (unlikely(v2 && !header_v2_matches(pc, data + header_first_start))) {
+		/* not the frames this context expects */
+		ring_consume(ring, header_first_end);
+
+		return PASS_FAILURE_GAP_DETECTED;
+	}
+
+	if (header_second_start > ring->count) {
+		/* partial frame, keep it from its header onwards */
+		ring_consume(ring, header_first_start);
+
+		return PASS_FAILURE_NO_DATA;
+	}
+
+	/*
+	 * io_uring reads ahead, when the next header has started to arrive it is
+	 * checked before a v1 frame is taken; v2 frames carry their length
+	 */
+	int following = ring->count - header_second_start;
+	if ((pc->uring != NULL) && (!v2) && (following > 0) && (following < PASS_DATA_HEADER_SIZE)) {
+		ring_consume(ring, header_first_start);
+
+		return PASS_FAILURE_NO_DATA;
+	}
+
+	/* the next header is checked when it is there */
+	if (likely((following < PASS_DATA_HEADER_SIZE) ||
+	           IS_PASS_DATA_HEADER(data + header_second_start))) {
+		pc->header = data + header_first_start;
+		pc->payload = (short *)(data + header_first_end);
+
+		ring_consume(ring, header_second_start);
+
+		return PASS_SUCCESS;
+	}
+
+	header_second_start = header_search(data, header_first_end, ring->count);
+	if (header_second_start < ring->count) {
+		/* the next header is elsewhere, the frame is the wrong length */
+		ring_consume(ring, header_second_start);
+	} else {
+		/* no header where the frame should end */
+		ring_consume(ring, ring->count - (PASS_DATA_HEADER_SIZE - 1));
+	}
+
+	return PASS_FAILURE_GAP_DETECTED;
+}
+
+static void sequence_id_update(pass_context *pc) {
+	unsigned char *h = pc->header;
+
+	if (header_is_v2(h)) {
+		memcpy(&(pc->sequence_id), h + offsetof(pass_header, sequence), sizeof(pc->sequence_id));
+		return;
+	}
+
+	uint32_t *tmp = (uint32_t *)(h + 28);
+	uint64_t s_id = bswap_32(*tmp);
+
+	pc->sequence_id = s_id;
+}
+
+/* with PASS_FLAG_CHECKSUM, counts the frame in frames_corrupt when its payload does not match */
+static bool frame_corrupt(pass_context *pc) {
+	if (!(pc->flags & PASS_FLAG_CHECKSUM) || (pc->header_size == 0))
+		return false;
+
+	uint16_t expected;
+	memcpy(&expected, pc->header + PASS_DATA_HEADER_SIZE - sizeof(expected), sizeof(expected));
+
+	int count = pc->sensor_count * pc->channel_count * pc->frame_size;
+	if (likely(checksum(pc->payload, count) == expected))
+		return false;
+
+	pc->frames_corrupt++;
+	return true;
+}
+
+/*
+ * Datagram ingest. Every frame arrives once as PASS_FRAGMENT_SIZE datagrams,
+ * whichever consumers have joined the group. Fragments are read in batches
+ * and copied into place at the start of the ring; a frame is handed out once
+ * all its fragments are in, anything that never completes is counted as lost.
+ */
+static void datagram_free(pass_context *pc) {
+	struct pass_datagram *d = pc->datagram;
+
+	if (d == NULL)
+		return;
+
+	free(d->fragments);
+	free(d->batch);
+	free(d);
+
+	pc->datagram = NULL;
+}
+
+static pass_response datagram_join(pass_context *pc, const char *group, const char *port) {
+	int rc;
+	int sd;
+
+	struct addrinfo hints;
+	memset(&hints, '\0', sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	/* fragments are numbered in 16 bits on the wire */
+	int frame_bytes = payload_size(pc) + pc->header_size;
+	int fragments = (frame_bytes + PASS_FRAGMENT_PAYLOAD - 1) / PASS_FRAGMENT_PAYLOAD;
+	return_failure_if((fragments > UINT16_MAX), PASS_FAILURE_GENERIC, "frames of %d bytes take %d fragments, udp carries at most %d", frame_bytes, fragments, UINT16_MAX);
+
+	struct addrinfo *group_address;
+	rc = getaddrinfo(group, port, &hints, &group_address);
+	return_failure_if((rc != 0), PASS_FAILURE_NO_CONN, "getaddrinfo() failed: %s", gai_strerror(rc));
+
+	info(stdout, "group address: %s %s", group, port);
+
+	sd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sd < 0) {
+		freeaddrinfo(group_address);
+		return_failure_if(true, PASS_FAILURE_NO_CONN, "socket() failed: %s", strerror(errno));
+	}
+
+	/* several consumers can share a host */
+	int y = 1;
+	rc = setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, (void *)&y, sizeof(y));
+	if (rc < 0) {
+		freeaddrinfo(group_address);
+		close(sd);
+		return_failure_if(true, PASS_FAILURE_NO_CONN, "setsockopt() failed: %s", strerror(errno));
+	}
+
+	/* room for a few frames while a frame is processed, the kernel caps it at rmem_max */
+	int receive_size = 4 * (frame_bytes + PASS_FRAGMENT_SIZE);
+	setsockopt(sd, SOL_SOCKET, SO_RCVBUF, (void *)&receive_size, sizeof(receive_size));
+
+	struct sockaddr_in *address = (struct sockaddr_in *)(group_address->ai_addr);
+	rc = bind(sd, group_address->ai_addr, group_address->ai_addrlen);
+	if (rc != 0) {
+		freeaddrinfo(group_address);
+		close(sd);
+		return_failure_if(true, PASS_FAILURE_NO_CONN, "bind() failed: %s", strerror(errno));
+	}
+
+	if (IN_MULTICAST(ntohl(address->sin_addr.s_addr))) {
+		struct ip_mreq membership;
+		membership.imr_multiaddr = address->sin_addr;
+		membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+		rc = setsockopt(sd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (void *)&membership, sizeof(membership));
+		if (rc < 0) {
+			freeaddrinfo(group_address);
+			close(sd);
+			return_failure_if(true, PASS_FAILURE_NO_CONN, "setsockopt() failed: %s", strerror(errno));
+		}
+	}
+
+	freeaddrinfo(group_address);
+
+	struct pass_datagram *d = calloc(1, sizeof(struct pass_datagram));
+	if (d == NULL) {
+		close(sd);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+	}
+	pc->datagram = d;
+
+	d->started = false;
+	d->fragments_total = fragments;
+	d->fragments = calloc(d->fragments_total, sizeof(unsigned char));
+	d->batch = malloc(DATAGRAM_BATCH * PASS_FRAGMENT_SIZE);
+	if ((d->fragments == NULL) || (d->batch == NULL)) {
+		datagram_free(pc);
+		close(sd);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+	}
+
+	for (int k = 0; k < DATAGRAM_BATCH; k++) {
+		d->iov[k].iov_base = d->batch + (k * PASS_FRAGMENT_SIZE);
+		d->iov[k].iov_len  = PASS_FRAGMENT_SIZE;
+
+		memset(&(d->messages[k]), 0, sizeof(struct mmsghdr));
+		d->messages[k].msg_hdr.msg_iov = &(d->iov[k]);
+		d->messages[k].msg_hdr.msg_iovlen = 1;
+	}
+
+	pc->fragments_lost = 0;
+	pc->frames_lost = 0;
+	pc->sd = sd;
+
+	return PASS_SUCCESS;
+}
+
+/* starts reassembling sequence, whatever was missing up to it is lost */
+static void datagram_restart(pass_context *pc, const uint32_t sequence, const int32_t ahead) {
+	struct pass_datagram *d = pc->datagram;
+
+	if (d->started && (ahead > 0)) {
+		if (d->fragments_received < d->fragments_total) {
+			pc->frames_lost++;
+			pc->fragments_lost += d->fragments_total - d->fragments_received;
+		}
+		pc->frames_lost += ahead - 1;
+		pc->fragments_lost += (uint64_t)(ahead - 1) * d->fragments_total;
+	}
+
+	d->started = true;
+	d->sequence = sequence;
+	d->fragments_received = 0;
+	memset(d->fragments, 0, d->fragments_total);
+}
+
+static pass_response datagram_read(pass_context *pc) {
+	struct pass_datagram *d = pc->datagram;
+
+	int frame_bytes = payload_size(pc) + pc->header_size;
+	unsigned char *frame = pc->ring.buffer;
+
+	while (true) {
+		if (d->pending_count == 0) {
+			int received = recvmmsg(pc->sd, d->messages, DATAGRAM_BATCH, MSG_WAITFORONE, NULL);
+			if (received < 0) {
+				if (errno == EINTR)
+					continue;
+				return PASS_FAILURE_GENERIC;
+			}
+
+			d->pending_start = 0;
+			d->pending_count = received;
+		}
+
+		while (d->pending_count > 0) {
+			int k = d->pending_start;
+			d->pending_start++;
+			d->pending_count--;
+
+			unsigned char *b = d->batch + (k * PASS_FRAGMENT_SIZE);
+			int length = (int)(d->messages[k].msg_len) - PASS_FRAGMENT_HEADER_SIZE;
+			if (length <= 0)
+				continue;
+
+			pass_fragment_header fh;
+			memcpy(&fh, b, PASS_FRAGMENT_HEADER_SIZE);
+
+			uint32_t sequence = ntohl(fh.sequence);
+			int index = ntohs(fh.index);
+			int offset = index * PASS_FRAGMENT_PAYLOAD;
+
+			if (((int)ntohl(fh.length) != frame_bytes) ||
+			    (ntohs(fh.count) != d->fragments_total) ||
+			    (offset + length > frame_bytes)) {
+				/* not a frame of this shape */
+				continue;
+			}
+
+			int32_t ahead = (int32_t)(sequence - d->sequence);
+			if ((!d->started) || (ahead > 0) || (ahead < -DATAGRAM_LATE)) {
+				/* a new frame, or the emitter started over */
+				datagram_restart(pc, sequence, ahead);
+			} else if ((ahead < 0) || d->fragments[index]) {
+				/* late or repeated */
+				continue;
+			}
+
+			memcpy(frame + offset, b + PASS_FRAGMENT_HEADER_SIZE, length);
+			d->fragments[index] = 1;
+			d->fragments_received++;
+
+			if (d->fragments_received == d->fragments_total) {
+				pc->header = (pc->header_size != 0) ? frame : NULL;
+				pc->payload = (short *)(frame + pc->header_size);
+				pc->sequence_id = sequence;
+
+				return PASS_SUCCESS;
+			}
+		}
+	}
+}
+
+/*
+ * Shared memory ingest. The producer never waits for consumers; each one
+ * keeps its own cursor, copies frames out of their slots and checks the slot
+ * sequence again afterwards, so a frame overwritten mid copy counts as lost.
+ */
+static void shm_free(pass_context *pc) {
+	struct pass_shm *m = pc->shm;
+
+	if (m == NULL)
+		return;
+
+	if (m->header != NULL)
+		munmap(m->header, m->size);
+	free(m);
+
+	pc->shm = NULL;
+}
+
+static pass_response shm_join(pass_context *pc, const char *name) {
+	char path[256];
+	snprintf(path, sizeof(path), "/%s", name);
+
+	int fd = shm_open(path, O_RDWR, 0);
+	return_failure_if((fd < 0), PASS_FAILURE_NO_CONN, "shm_open() failed: %s: %s", path, strerror(errno));
+
+	struct stat st;
+	int rc = fstat(fd, &st);
+	if ((rc != 0) || ((size_t)st.st_size < sizeof(pass_shm_header))) {
+		close(fd);
+		return_failure_if(true, PASS_FAILURE_NO_CONN, "shared memory not initialised: %s", path);
+	}
+
+	pass_shm_header *header = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return_failure_if((header == MAP_FAILED), PASS_FAILURE_NO_CONN, "mmap() failed: %s", strerror(errno));
+
+	int frame_bytes = payload_size(pc) + pc->header_size;
+	if ((header->magic != PASS_SHM_MAGIC) ||
+	    ((int)(header->frame_bytes) != frame_bytes) ||
+	    ((size_t)st.st_size < PASS_SHM_ALIGN + (size_t)(header->slot_count) * header->slot_size)) {
+		munmap(header, st.st_size);
+		return_failure_if(true, PASS_FAILURE_NO_CONN, "shared memory frames do not match: %s", path);
+	}
+
+	struct pass_shm *m = calloc(1, sizeof(struct pass_shm));
+	if (m == NULL) {
+		munmap(header, st.st_size);
+		return_failure_if(true, PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+	}
+
+	m->header = header;
+	m->size = st.st_size;
+	m->slots = (unsigned char *)header + PASS_SHM_ALIGN;
+
+	/* start with the next frame published */
+	m->cursor = __atomic_load_n(&(header->published), __ATOMIC_ACQUIRE);
+
+	info(stdout, "shared memory: %s, %u slots", path, header->slot_count);
+
+	pc->shm = m;
+	pc->frames_lost = 0;
+
+	return PASS_SUCCESS;
+}
+
+static void shm_wait(pass_shm_header *header, const uint32_t futex) {
+	__atomic_add_fetch(&(header->waiters), 1, __ATOMIC_SEQ_CST);
+
+	/* a publish between reading futex and here changes it, the wait returns at once */
+	struct timespec timeout = { 1, 0 };
+	syscall(SYS_futex, &(header->futex), FUTEX_WAIT, futex, &timeout, NULL, 0);
+
+	__atomic_sub_fetch(&(header->waiters), 1, __ATOMIC_SEQ_CST);
+}
+
+static pass_response shm_read(pass_context *pc) {
+	struct pass_shm *m = pc->shm;
+	pass_shm_header *header = m->header;
+
+	int frame_bytes = header->frame_bytes;
+	unsigned char *frame = pc->ring.buffer;
+
+	while (true) {
+		uint32_t futex = __atomic_load_n(&(header->futex), __ATOMIC_ACQUIRE);
+		uint64_t published = __atomic_load_n(&(header->published), __ATOMIC_ACQUIRE);
+
+		if (unlikely(m->cursor > published)) {
+			/* the producer started over */
+			m->cursor = published;
+		}
+
+		if (m->cursor == published) {
+			if (__atomic_load_n(&(header->closed), __ATOMIC_ACQUIRE))
+				return PASS_FAILURE_NO_CONN;
+
+			shm_wait(header, futex);
+			continue;
+		}
+
+		if (published - m->cursor >= header->slot_count) {
+			/* fell behind, the oldest frames were overwritten */
+			uint64_t oldest = published - header->slot_count + 1;
+			pc->frames_lost += oldest - m->cursor;
+			m->cursor = oldest;
+		}
+
+		unsigned char *slot = m->slots + (m->cursor % header->slot_count) * header->slot_size;
+		uint64_t *sequence = (uint64_t *)slot;
+		uint64_t expected = 2 * (m->cursor + 1);
+
+		m->cursor++;
+
+		if (__atomic_load_n(sequence, __ATOMIC_ACQUIRE) != expected) {
+			pc->frames_lost++;
+			continue;
+		}
+
+		memcpy(frame, slot + PASS_SHM_ALIGN, frame_bytes);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(sequence, __ATOMIC_RELAXED) != expected) {
+			/* overwritten while copying */
+			pc->frames_lost++;
+			continue;
+		}
+
+		pc->header = (pc->header_size != 0) ? frame : NULL;
+		pc->payload = (short *)(frame + pc->header_size);
+		pc->sequence_id = m->cursor - 1;
+
+		return PASS_SUCCESS;
+	}
+}
+
+/*
+ * io_uring ingest. The ring is cut into slices that are registered as a
+ * provided buffer group consumed incrementally, so one multishot receive has
+ * the kernel write straight into the ring, in order, and pass_read only reaps
+ * completions. Slices are handed back once everything in them is consumed.
+ */
+static void uring_provide(pass_context *pc) {
+	struct pass_uring *u = pc->uring;
+	pass_ring *ring = &(pc->ring);
+
+	uint64_t consumed = u->written - ring->count;
+
+	while (true) {
+		int offset = (int)(u->provided % ring->total);
+		int length = ring->total - offset;
+		if (length > u->slice_size)
+			length = u->slice_size;
+
+		if (u->provided + length > consumed + ring->total)
+			break;
+
+		struct io_uring_buf *b = &(u->buffers->bufs[u->buffers_tail & (URING_SLICES - 1)]);
+		b->addr = (uint64_t)(uintptr_t)(ring->buffer + offset);
+		b->len  = length;
+		b->bid  = offset / u->slice_size;
+
+		u->buffers_tail++;
+		u->provided += length;
+	}
+
+	__atomic_store_n(&(u->buffers->tail), u->buffers_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_submit(struct pass_uring *u, const struct io_uring_sqe *sqe) {
+	unsigned tail = *(u->sq_tail);
+	unsigned index = tail & *(u->sq_mask);
+
+	u->sqes[index] = *sqe;
+	u->sq_array[index] = index;
+
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_enter(struct pass_uring *u, const unsigned wait) {
+	unsigned submit = __atomic_load_n(u->sq_tail, __ATOMIC_RELAXED) - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+	int rc;
+	do {
+		rc = syscall(__NR_io_uring_enter, u->fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+	} while ((rc < 0) && (errno == EINTR));
+
+	return rc;
+}
+
+static void uring_arm(pass_context *pc) {
+	struct pass_uring *u = pc->uring;
+
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode    = IORING_OP_RECV;
+	sqe.fd        = pc->sd;
+	sqe.ioprio    = IORING_RECV_MULTISHOT;
+	sqe.flags     = IOSQE_BUFFER_SELECT;
+	sqe.buf_group = 0;
+	sqe.user_data = URING_RECV;
+
+	uring_submit(u, &sqe);
+	u->armed = true;
+}
+
+/* returns the number of bytes added to the ring, -1 on end of stream or error */
+static int uring_reap(pass_context *pc, bool *no_buffers) {
+	struct pass_uring *u = pc->uring;
+	pass_ring *ring = &(pc->ring);
+
+	int added = 0;
+	bool failed = false;
+
+	unsigned head = *(u->cq_head);
+	unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &(u->cqes[head & *(u->cq_mask)]);
+		if (cqe->user_data != URING_RECV)
+			continue;
+
+		if (!(cqe->flags & IORING_CQE_F_MORE))
+			u->armed = false;
+
+		if (cqe->res > 0) {
+			ring->count += cqe->res;
+			u->written += cqe->res;
+			added += cqe->res;
+		} else if (cqe->res == -ENOBUFS) {
+			*no_buffers = true;
+		} else if ((cqe->res < 0) && (cqe->res != -ECANCELED)) {
+			failed = true;
+		}
+	}
+
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+	return failed ? -1 : added;
+}
+
+static void uring_cancel(pass_context *pc) {
+	struct pass_uring *u = pc->uring;
+	bool no_buffers = false;
+
+	if (!u->armed)
+		return;
+
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode    = IORING_OP_ASYNC_CANCEL;
+	sqe.fd        = -1;
+	sqe.addr      = URING_RECV;
+	sqe.user_data = URING_CANCEL;
+
+	uring_submit(u, &sqe);
+
+	while (u->armed) {
+		if (uring_enter(u, 1) < 0)
+			break;
+		uring_reap(pc, &no_buffers);
+	}
+	u->armed = false;
+}
+
+static void uring_free(pass_context *pc) {
+	struct pass_uring *u = pc->uring;
+
+	if (u == NULL)
+		return;
+
+	uring_cancel(pc);
+
+	if (u->buffers != NULL)
+		munmap(u->buffers, u->buffers_size);
+	if (u->sqes != NULL)
+		munmap(u->sqes, u->sqes_size);
+	if ((u->cq_ring != NULL) && (u->cq_ring != u->sq_ring))
+		munmap(u->cq_ring, u->cq_ring_size);
+	if (u->sq_ring != NULL)
+		munmap(u->sq_ring, u->sq_ring_size);
+	if (u->fd >= 0)
+		close(u->fd);
+
+	free(u);
+	pc->uring = NULL;
+}
+
+static pass_response uring_init(pass_context *pc) {
+	struct pass_uring *u = calloc(1, sizeof(struct pass_uring));
+	return_failure_if((u == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+	pc->uring = u;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (u->fd < 0) {
+		uring_free(pc);
+		return PASS_FAILURE_GENERIC;
+	}
+
+	u->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	u->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_ring_size > u->sq_ring_size)
+			u->sq_ring_size = u->cq_ring_size;
+		u->cq_ring_size = u->sq_ring_size;
+	}
+
+	void *sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED) {
+		uring_free(pc);
+		return PASS_FAILURE_GENERIC;
+	}
+	u->sq_ring = sq_ring;
+
+	void *cq_ring = sq_ring;
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+		cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED) {
+			uring_free(pc);
+			return PASS_FAILURE_GENERIC;
+		}
+	}
+	u->cq_ring = cq_ring;
+
+	u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		uring_free(pc);
+		return PASS_FAILURE_GENERIC;
+	}
+	u->sqes = sqes;
+
+	u->sq_head  = (unsigned *)((char *)sq_ring + params.sq_off.head);
+	u->sq_tail  = (unsigned *)((char *)sq_ring + params.sq_off.tail);
+	u->sq_mask  = (unsigned *)((char *)sq_ring + params.sq_off.ring_mask);
+	u->sq_array = (unsigned *)((char *)sq_ring + params.sq_off.array);
+	u->cq_head  = (unsigned *)((char *)cq_ring + params.cq_off.head);
+	u->cq_tail  = (unsigned *)((char *)cq_ring + params.cq_off.tail);
+	u->cq_mask  = (unsigned *)((char *)cq_ring + params.cq_off.ring_mask);
+	u->cqes     = (struct io_uring_cqe *)((char *)cq_ring + params.cq_off.cqes);
+
+	/* provided buffer ring, page aligned */
+	u->buffers_size = URING_SLICES * sizeof(struct io_uring_buf);
+	void *buffers = mmap(NULL, u->buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED) {
+		uring_free(pc);
+		return PASS_FAILURE_NOMEM;
+	}
+	u->buffers = buffers;
+
+	struct uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr    = (uint64_t)(uintptr_t)buffers;
+	reg.ring_entries = URING_SLICES;
+	reg.bgid         = 0;
+	reg.flags        = URING_PBUF_RING_INC;
+
+	if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		uring_free(pc);
+		return PASS_FAILURE_GENERIC;
+	}
+
+	/* whole pages, at most URING_SLICES of them cover the ring */
+	long page_size = sysconf(_SC_PAGESIZE);
+	long slice = (pc->ring.total + URING_SLICES - 1) / URING_SLICES;
+	u->slice_size = (int)(((slice + page_size - 1) / page_size) * page_size);
+
+	u->buffers_tail = 0;
+	u->written = 0;
+	u->provided = 0;
+	uring_provide(pc);
+
+	return PASS_SUCCESS;
+}
+
+/*
+ * Waits until a whole frame, and with headers the header after it, could be
+ * in the ring. Framing is left to pass_gaps_detection as on the read() path.
+ */
+static pass_response uring_read(pass_context *pc) {
+	struct pass_uring *u = pc->uring;
+	pass_ring *ring = &(pc->ring);
+
+	int remaining = payload_size(pc) + pc->header_size;
+	if ((pc->header_size != 0) && (ring->count > remaining)) {
+		/* the next header has started to arrive, frame_next waits for the rest of it */
+		remaining += pc->header_size;
+	}
+
+	uring_provide(pc);
+
+	while (ring->count < remaining) {
+		bool no_buffers = false;
+
+		if (!u->armed)
+			uring_arm(pc);
+
+		if (uring_enter(u, 1) < 0)
+			return PASS_FAILURE_GENERIC;
+
+		int added = uring_reap(pc, &no_buffers);
+		if (added < 0)
+			return PASS_FAILURE_GENERIC;
+
+		uring_provide(pc);
+		if (unlikely(no_buffers) && (u->provided == u->written) && (ring->count < remaining)) {
+			/* too much data, emptying buffer */
+			ring_discard(ring);
+			uring_provide(pc);
+		}
+
+		if ((added == 0) && !no_buffers && !u->armed) {
+			/* end of stream */
+			return PASS_FAILURE_GENERIC;
+		}
+	}
+
+	if (pc->header_size == 0) {
+		pc->payload = (short *)(ring->buffer + ring->start);
+		ring_consume(ring, remaining);
+	}
+
+	return PASS_SUCCESS;
+}
+
+/* hands out tasks of the current batch until there are none left */
+static void pool_drain(pass_pool *pool, const int worker) {
+	pthread_mutex_lock(&(pool->lock));
+
+	while (pool->next < pool->count) {
+		int task = pool->next++;
+		pass_pool_task run = pool->task;
+		void *user_data = pool->user_data;
+
+		pthread_mutex_unlock(&(pool->lock));
+		run(user_data, task, worker);
+		pthread_mutex_lock(&(pool->lock));
+
+		pool->completed++;
+		if (pool->completed == pool->count)
+			pthread_cond_broadcast(&(pool->finished));
+	}
+
+	pthread_mutex_unlock(&(pool->lock));
+}
+
+struct pool_start {
+	pass_pool *pool;
+	int worker;
+};
+
+static void *pool_worker(void *data) {
+	struct pool_start *start = data;
+	pass_pool *pool = start->pool;
+	int worker = start->worker;
+	free(start);
+
+	uint64_t seen = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&(pool->lock));
+		while ((!pool->stop) && (pool->batch == seen))
+			pthread_cond_wait(&(pool->ready), &(pool->lock));
+
+		if (pool->stop) {
+			pthread_mutex_unlock(&(pool->lock));
+			break;
+		}
+
+		seen = pool->batch;
+		pthread_mutex_unlock(&(pool->lock));
+
+		pool_drain(pool, worker);
+	}
+
+	return NULL;
+}
+
+pass_response pass_array_allocate(pass_array *array, const int total) {
+	array->values = malloc(sizeof(double) * total);
+	return_failure_if((array->values == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	array->values_f = NULL;
+	array->count = 0;
+	array->total = total;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_array_allocate_single(pass_array *array, const int total) {
+	array->values_f = malloc(sizeof(float) * total);
+	return_failure_if((array->values_f == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	array->values = NULL;
+	array->count = 0;
+	array->total = total;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_array_free(pass_array *array) {
+	if (array->values != NULL) {
+		free(array->values);
+		array->values = NULL;
+	}
+
+	if (array->values_f != NULL) {
+		free(array->values_f);
+		array->values_f = NULL;
+	}
+
+	array->count = 0;
+	array->total = 0;
+
+	return PASS_SUCCESS;
+}
+
+void pass_close(pass_context *pc) {
+	if (pc->uring != NULL)
+		uring_cancel(pc);
+
+	datagram_free(pc);
+	shm_free(pc);
+
+	if (pc->sd >= 0)
+		close(pc->sd);
+	pc->sd = -1;
+}
+
+pass_response pass_connect(pass_context *pc, const char *server, const char *port) {
+	int rc;
+	int sd;
+
+	if (strncmp(server, "udp://", 6) == 0)
+		return datagram_join(pc, server + 6, port);
+
+	if (strncmp(server, "shm://", 6) == 0)
+		return shm_join(pc, server + 6);
+
+	debug(stdout, "configuring remote address");
+
+	struct addrinfo hints;
+	memset(&hints, '\0', sizeof(hints));
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *peer_address;
+	rc = getaddrinfo(server, port, &hints, &peer_address);
+	return_failure_if((rc != 0), PASS_FAILURE_NO_CONN, "getaddrinfo() failed: %s", strerror(errno));
+
+	char address_buffer[128];
+	char service_buffer[128];
+	getnameinfo(
+		peer_address->ai_addr,
+		peer_address->ai_addrlen,
+		address_buffer,
+		sizeof(address_buffer),
+		service_buffer,
+		sizeof(service_buffer),
+		NI_NUMERICHOST);
+	info(stdout, "server address: %s %s", address_buffer, service_buffer);
+
+	debug(stdout, "creating socket");
+
+	sd = socket(
+		peer_address->ai_family,
+		peer_address->ai_socktype,
+		peer_address->ai_protocol);
+	return_failure_if((sd < 0), PASS_FAILURE_NO_CONN, "socket() failed: %s", strerror(errno));
+
+	debug(stdout, "connecting");
+
+	rc = connect(
+		sd,
+		peer_address->ai_addr,
+		peer_address->ai_addrlen);
+	return_failure_if((rc != 0), PASS_FAILURE_NO_CONN, "connect() failed: %s", strerror(errno));
+
+	freeaddrinfo(peer_address);
+
+	pc->sd = sd;
+
+	debug(stdout, "connected");
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_context_free(pass_context *pc) {
+	pc->sequence_id = 0;
+
+	pc->sensor_count  = 0;
+	pc->channel_count = 0;
+	pc->sample_rate   = 0;
+	pc->frame_size    = 0;
+	pc->header_size   = 0;
+
+	uring_free(pc);
+	pc->flags = 0;
+
+	datagram_free(pc);
+	shm_free(pc);
+
+	if (pc->sd >= 0)
+		close(pc->sd);
+	pc->sd = -1;
+
+	ring_free(&(pc->ring));
+
+	if (pc->sync_header != NULL) {
+		free(pc->sync_header);
+		pc->sync_header = NULL;
+	}
+	if (pc->sync_payload != NULL) {
+		free(pc->sync_payload);
+		pc->sync_payload = NULL;
+	}
+	pc->in_sync = false;
+	pc->placed = false;
+
+	pc->payload = NULL;
+	pc->header  = NULL;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_context_init(
+	pass_context *pc,
+	int sensor_count,
+	int channel_count,
+	int sample_rate,
+	int frame_size,
+	bool contains_header,
+	int flags) {
+
+	if (pc == NULL) {
+		pc = malloc(sizeof(pass_context));
+		return_failure_if((pc == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+	}
+	memset(pc, 0, sizeof(pass_context));
+
+	return_failure_if((sensor_count < 1) || (channel_count < 1), PASS_FAILURE_GENERIC, "%d sensors and %d channels, at least 1 of each", sensor_count, channel_count);
+	return_failure_if((frame_size < 1) || (sample_rate < 1), PASS_FAILURE_GENERIC, "invalid frame size %d or sample rate %d", frame_size, sample_rate);
+
+	/* the ring holds two frames and counts its bytes in an int, with room to round up to pages */
+	long frame_limit = ((INT_MAX / 4) - PASS_DATA_HEADER_SIZE) / (long)(sizeof(short));
+	return_failure_if((frame_size > frame_limit / channel_count / sensor_count), PASS_FAILURE_GENERIC,
+		"frames of %d samples from %d sensors and %d channels, at most %ld samples in all", frame_size, sensor_count, channel_count, frame_limit);
+
+	pc->sequence_id = 0;
+	pc->sensor_count = sensor_count;
+	pc->channel_count = channel_count;
+	pc->sample_rate = sample_rate;
+	pc->frame_size = frame_size;
+
+	pc->header_size = 0;
+	if (contains_header)
+		pc->header_size = 42;
+
+	pc->sd = -1;
+	pc->flags = flags;
+	pc->uring = NULL;
+	pc->datagram = NULL;
+	pc->shm = NULL;
+	pc->fragments_lost = 0;
+	pc->frames_lost = 0;
+	pc->frames_corrupt = 0;
+
+	pc->ring.buffer   = NULL;
+	pc->in_sync       = false;
+	pc->placed        = false;
+	pc->sync_header   = NULL;
+	pc->sync_payload  = NULL;
+	pc->payload       = NULL;
+	pc->header        = NULL;
+
+	int rc;
+	long buffer_size = 0;
+	long samples_total = (long)(pc->frame_size) * pc->channel_count * pc->sensor_count;
+
+	// alloc ring, room for a partial frame plus the next read
+	buffer_size = 2 * ((sizeof(short) * samples_total) + pc->header_size);
+	pass_response pr = ring_allocate(&(pc->ring), buffer_size);
+	if (pr != PASS_SUCCESS)
+		return pr;
+
+	// alloc in sync header and payload
+	if (contains_header) {
+		buffer_size = pc->header_size;
+		pc->sync_header = malloc(buffer_size);
+		return_failure_if((pc->sync_header == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+		memset(pc->sync_header, '\0', buffer_size);
+
+		buffer_size = sizeof(short) * samples_total;
+		rc = posix_memalign((void **)&(pc->sync_payload), 64, buffer_size);
+		return_failure_if((rc != 0), PASS_FAILURE_NOMEM, "posix_memalign() failed: %s", strerror(rc));
+	}
+
+	if (flags & PASS_FLAG_IO_URING) {
+		pr = uring_init(pc);
+		if (pr == PASS_FAILURE_NOMEM)
+			return pr;
+		if (pr != PASS_SUCCESS) {
+			info(stdout, "io_uring unavailable, reading with read()");
+			pc->flags &= ~PASS_FLAG_IO_URING;
+		}
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_convert_to_doubles(
+	pass_array *array,
+	const pass_context *pc,
+	const int sensor,
+	const int channel,
+	const double gradient,
+	const double offset) {
+
+	return_failure_if((pc->frame_size > array->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	int count = pc->sensor_count * pc->channel_count * pc->frame_size;
+
+	int i = 0;
+	for (int c = 0; c < count; c += (pc->sensor_count * pc->channel_count)) {
+		int l = c + (sensor * pc->channel_count) + channel;
+		short s = sample_get(pc->payload, l, (pc->flags & PASS_FLAG_ENDIAN_SWAP) != 0);
+
+		if (array->values_f != NULL)
+			array->values_f[i] = ((float)(s)) * (float)(gradient) + (float)(offset);
+		else
+			array->values[i] = ((double)(s)) * gradient + offset;
+		i++;
+	}
+
+	array->count = i;
+	array->sequence_id = pc->sequence_id;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_cumulative_bands(const pass_cumulative *cumulative, pass_array *output, const pass_fftw_plan *plan, const int lower, const int upper) {
+	int index_lower, index_upper;
+
+	index_lower = (lower <= plan->octave_smallest) ? 0 : lower - plan->octave_smallest;
+	index_upper = (upper - plan->octave_smallest >= plan->octave_bands_count) ? plan->octave_bands_count : upper - plan->octave_smallest;
+
+	/* bands reaching past the last bin are left out, as in pass_octave_bands */
+	while ((index_upper > index_lower) && (plan->octave_bands[index_upper - 1].upper >= cumulative->count)) {
+		index_upper--;
+	}
+
+	return_failure_if((index_upper - index_lower > output->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	const pass_octave_band *bands = plan->octave_bands;
+
+	int i = 0;
+	for (int j = index_lower; j < index_upper; j++) {
+		double sum = bands[j].lower_weight * cumulative_between(cumulative, bands[j].lower, bands[j].lower + 1);
+		if (bands[j].upper > bands[j].lower) {
+			sum += cumulative_between(cumulative, bands[j].lower + 1, bands[j].upper);
+		}
+		sum += bands[j].upper_weight * cumulative_between(cumulative, bands[j].upper, bands[j].upper + 1);
+
+		if (plan->octave_weights != NULL)
+			sum *= plan->octave_weights[j];
+
+		if (output->values_f != NULL)
+			output->values_f[i] = (float)(sum);
+		else
+			output->values[i] = sum;
+		i++;
+	}
+	output->count = i;
+	output->sequence_id = cumulative->sequence_id;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_cumulative_bins(const pass_cumulative *cumulative, pass_array *output, const int lower, const int upper, const int stride) {
+	int bins = (upper > lower) ? ((upper - lower) + stride - 1) / stride : 0;
+	return_failure_if((stride < 1) || (lower < 0), PASS_FAILURE_GENERIC, "invalid bins %d to %d by %d", lower, upper, stride);
+	return_failure_if((lower + (bins * stride) > cumulative->count), PASS_FAILURE_GENERIC, "bins reach past the spectrum");
+	return_failure_if((bins > output->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	for (int j = 0; j < bins; j++) {
+		int i = lower + (j * stride);
+		double sum = cumulative_between(cumulative, i, i + stride);
+
+		if (output->values_f != NULL)
+			output->values_f[j] = (float)(sum);
+		else
+			output->values[j] = sum;
+	}
+	output->count = bins;
+	output->sequence_id = cumulative->sequence_id;
+
+	return PASS_SUCCESS;
+}
+
+/*
+ * Neumaier's compensated sum, the carry collects the low order bits each
+ * addition rounds away, whichever of the two terms is the larger.
+ */
+pass_response pass_cumulative_execute(pass_cumulative *cumulative, const pass_array *input) {
+	return_failure_if((input->count > cumulative->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	double sum = 0.0;
+	double carry = 0.0;
+
+	cumulative->sum[0] = 0.0;
+	cumulative->carry[0] = 0.0;
+
+	for (int i = 0; i < input->count; i++) {
+		double value = (input->values_f != NULL) ? (double)(input->values_f[i]) : input->values[i];
+		double next = sum + value;
+
+		if (fabs(sum) >= fabs(value))
+			carry += (sum - next) + value;
+		else
+			carry += (value - next) + sum;
+		sum = next;
+
+		cumulative->sum[i + 1] = sum;
+		cumulative->carry[i + 1] = carry;
+	}
+	cumulative->count = input->count;
+	cumulative->sequence_id = input->sequence_id;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_cumulative_init(pass_cumulative *cumulative, const int bins) {
+	return_failure_if((bins < 1), PASS_FAILURE_GENERIC, "invalid bins %d", bins);
+
+	cumulative->sequence_id = 0;
+	cumulative->count = 0;
+	cumulative->total = bins;
+
+	cumulative->sum = malloc(sizeof(double) * (bins + 1));
+	cumulative->carry = malloc(sizeof(double) * (bins + 1));
+	return_failure_if((cumulative->sum == NULL) || (cumulative->carry == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	cumulative->sum[0] = 0.0;
+	cumulative->carry[0] = 0.0;
+
+	return PASS_SUCCESS;
+}
+
+double pass_cumulative_range(const pass_cumulative *cumulative, const int lower, const int upper) {
+	int l = (lower < 0) ? 0 : lower;
+	int u = (upper > cumulative->count) ? cumulative->count : upper;
+
+	return (u > l) ? cumulative_between(cumulative, l, u) : 0.0;
+}
+
+pass_response pass_cumulative_term(pass_cumulative *cumulative) {
+	free(cumulative->sum);
+	free(cumulative->carry);
+
+	cumulative->sum = NULL;
+	cumulative->carry = NULL;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_curl_init()
+{
+	CURLcode cr;
+	cr = curl_global_init(CURL_GLOBAL_ALL);
+	if (cr != CURLE_OK)
+		return PASS_FAILURE_CURL;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_curl_post(
+	const char *url,
+	const pass_array *input,
+	const char *name,
+	const char *msg_type,
+	const int sensor,
+	const int channel) {
+
+	CURL *curl;
+	CURLcode cr;
+	struct curl_slist *headers = NULL;
+
+	json_object *jobject = json_object_new_object();
+
+	json_object *jstring = json_object_new_string(name);
+	json_object *jmsg_type = json_object_new_string(msg_type);
+	json_object *jsensor = json_object_new_int(sensor);
+	json_object *jchannel = json_object_new_int(channel);
+
+	json_object *jarray = json_object_new_array();
+	for (int i = 0; i < input->count; i++) {
+		double value = (input->values_f != NULL) ? input->values_f[i] : input->values[i];
+		json_object *jdouble = json_object_new_double(value);
+		json_object_array_add(jarray, jdouble);
+	}
+
+	json_object_object_add(jobject, "name", jstring);
+	json_object_object_add(jobject, "type", jmsg_type);
+	json_object_object_add(jobject, "sensor", jsensor);
+	json_object_object_add(jobject, "channel", jchannel);
+	json_object_object_add(jobject, "values", jarray);
+
+	curl = curl_easy_init();
+	if (curl == NULL)
+		return PASS_FAILURE_CURL;
+
+	headers = curl_slist_append(headers, "Accept: application/json");
+	headers = curl_slist_append(headers, "Content-Type: application/json");
+	headers = curl_slist_append(headers, "charsets: utf-8");
+
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(jobject));
+
+	cr = curl_easy_perform(curl);
+	if (cr != CURLE_OK)
+		return PASS_FAILURE_CURL;
+
+	curl_easy_cleanup(curl);
+	curl_slist_free_all(headers);
+
+	json_object_put(jobject);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_curl_term()
+{
+	curl_global_cleanup();
+	return PASS_SUCCESS;
+}
+
+void pass_decibels(pass_array *input, const double reference, const double correction) {
+	if (input->values_f != NULL) {
+		float r = (float)(reference);
+		float c = (float)(correction);
+
+		for (int i = 0; i < input->count; i++) {
+			input->values_f[i] = 10.0f * log10f(input->values_f[i] / r) + c;
+		}
+		return;
+	}
+
+	for (int i = 0; i < input->count; i++) {
+		input->values[i] = 10.0 * log10(input->values[i] / reference) + correction;
+	}
+}
+
+pass_response pass_deinterleave(
+	pass_array *arrays,
+	const pass_context *pc,
+	const double *gradient,
+	const double *offset) {
+
+	int stride = pc->sensor_count * pc->channel_count;
+
+	bool swap = (pc->flags & PASS_FLAG_ENDIAN_SWAP) != 0;
+
+	bool single = (arrays[0].values_f != NULL);
+
+	void *out[stride];
+	for (int c = 0; c < stride; c++) {
+		return_failure_if((pc->frame_size > arrays[c].total), PASS_FAILURE_NOMEM, "insufficent memory");
+		return_failure_if(((arrays[c].values_f != NULL) != single), PASS_FAILURE_GENERIC, "arrays of mixed precision");
+		out[c] = single ? (void *)(arrays[c].values_f) : (void *)(arrays[c].values);
+	}
+
+	deinterleave(out, pc->payload, stride, pc->frame_size, swap, single, gradient, offset, NULL);
+
+	for (int c = 0; c < stride; c++) {
+		arrays[c].count = pc->frame_size;
+		arrays[c].sequence_id = pc->sequence_id;
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_endian_swap(pass_context *pc) {
+	int count = pc->sensor_count * pc->channel_count * pc->frame_size;
+	short *buffer = pc->payload;
+
+	for (int i = 0; i < count; i++) {
+		buffer[i] = bswap_16(buffer[i]);
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_execute(pass_array *array, pass_fftw_plan *plan) {
+	bool single = (plan->flags & PASS_PLAN_SINGLE) != 0;
+	return_failure_if(((array->values_f != NULL) != single), PASS_FAILURE_GENERIC, "array and plan precision differ");
+	return_failure_if((plan->transforms != 1), PASS_FAILURE_GENERIC, "batched plan, use pass_fftw_execute_many");
+
+	/* the frame is read from the array and the spectrum written back over it */
+	return_failure_if((array->total < plan->frame_size) || (array->total < plan->output_rate), PASS_FAILURE_NOMEM,
+		"array of %d values for a plan of %d samples and %d bins", array->total, plan->frame_size, plan->output_rate);
+
+	if (plan->windowed != NULL) {
+		for (int i = 0; i < plan->frame_size; i++)
+			plan->windowed[i] = (single ? (double)(array->values_f[i]) : array->values[i]) * plan->window[i];
+
+		/* the spectrum is built in the input's place, zeros below the needed bins */
+		double *values = single ? plan->decimated : array->values;
+		spectrum_pruned(values, plan);
+
+		for (int k = 0; k < plan->lower; k++)
+			values[k] = 0.0;
+
+		if (single) {
+			for (int k = 0; k < plan->output_rate; k++)
+				array->values_f[k] = (float)(values[k]);
+		}
+		array->count = plan->output_rate;
+
+		return PASS_SUCCESS;
+	}
+
+	if (single) {
+		for (int i = 0; i < plan->frame_size; i++) {
+			plan->input_f[i] = array->values_f[i] * plan->window_f[i];
+		}
+
+		fftwf_execute(plan->plan_forward_f);
+	} else {
+		for (int i = 0; i < plan->frame_size; i++) {
+			plan->input[i] = array->values[i] * plan->window[i];
+		}
+
+		fftw_execute(plan->plan_forward);
+	}
+
+	power_spectrum(array, plan, 0);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_execute_many(
+	pass_array *arrays,
+	const pass_context *pc,
+	pass_fftw_plan *plan,
+	const double *gradient,
+	const double *offset) {
+
+	int stride = pc->sensor_count * pc->channel_count;
+
+	bool swap = (pc->flags & PASS_FLAG_ENDIAN_SWAP) != 0;
+	bool single = (plan->flags & PASS_PLAN_SINGLE) != 0;
+
+	return_failure_if((stride != plan->transforms), PASS_FAILURE_GENERIC, "plan has %d transforms, context %d streams", plan->transforms, stride);
+	return_failure_if((pc->frame_size != plan->frame_size), PASS_FAILURE_GENERIC, "plan and context frame sizes differ");
+	return_failure_if((plan->windowed != NULL), PASS_FAILURE_GENERIC, "pruned plan, use pass_fftw_execute");
+
+	/* the windowed samples go straight into the plan's channel major input */
+	void *in[stride];
+	for (int c = 0; c < stride; c++) {
+		return_failure_if((plan->output_rate > arrays[c].total), PASS_FAILURE_NOMEM, "insufficent memory");
+		return_failure_if(((arrays[c].values_f != NULL) != single), PASS_FAILURE_GENERIC, "array and plan precision differ");
+
+		if (single)
+			in[c] = plan->input_f + ((size_t)(c) * plan->frame_size);
+		else
+			in[c] = plan->input + ((size_t)(c) * plan->frame_size);
+	}
+
+	if (single) {
+		deinterleave(in, pc->payload, stride, pc->frame_size, swap, true, gradient, offset, plan->window_f);
+		fftwf_execute(plan->plan_forward_f);
+	} else {
+		deinterleave(in, pc->payload, stride, pc->frame_size, swap, false, gradient, offset, plan->window);
+		fftw_execute(plan->plan_forward);
+	}
+
+	for (int c = 0; c < stride; c++) {
+		power_spectrum(&arrays[c], plan, c);
+		arrays[c].sequence_id = pc->sequence_id;
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_plan_bands(pass_fftw_plan *plan, const int fraction) {
+	return_failure_if((fraction < 1), PASS_FAILURE_GENERIC, "invalid octave fraction %d", fraction);
+
+	/* centres from 10 Hz to 200 kHz, as the 1/3 octave bands 10 to 53 */
+	int smallest = pass_octave_band_number(fraction, 10.0);
+	int largest = pass_octave_band_number(fraction, 200000.0);
+
+	pass_octave_band *bands = realloc(plan->octave_bands, sizeof(pass_octave_band) * (largest - smallest + 1));
+	return_failure_if((bands == NULL), PASS_FAILURE_NOMEM, "realloc() failed: %s", strerror(errno));
+
+	plan->octave_fraction = fraction;
+	plan->octave_smallest = smallest;
+	plan->octave_bands_count = largest - smallest + 1;
+	plan->octave_bands = bands;
+
+	octave_bands_generate(plan->octave_bands, plan->octave_fraction, plan->octave_smallest, plan->octave_bands_count, plan->bin_width);
+
+	/* the weights follow the bands */
+	return pass_fftw_plan_weighting(plan, plan->weighting);
+}
+
+pass_response pass_fftw_plan_init(pass_fftw_plan *plan, const int sample_rate, const int frame_size, const int flags)
+{
+	return pass_fftw_plan_init_many(plan, sample_rate, frame_size, 1, flags);
+}
+
+pass_response pass_fftw_plan_init_many(
+	pass_fftw_plan *plan,
+	const int sample_rate,
+	const int frame_size,
+	const int transforms,
+	const int flags) {
+
+	plan->sample_rate = sample_rate;
+	plan->frame_size = frame_size;
+	plan->output_rate = (frame_size / 2) + 1;
+	plan->bin_width = (double)(sample_rate) / (double)(frame_size);
+	plan->transforms = transforms;
+	plan->flags = flags;
+
+	plan->plan_forward = NULL;
+	plan->result = NULL;
+	plan->input = NULL;
+	plan->plan_forward_f = NULL;
+	plan->result_f = NULL;
+	plan->input_f = NULL;
+	plan->window_f = NULL;
+
+	plan->engine = PASS_ENGINE_FFT;
+	plan->lower = 0;
+	plan->upper = plan->output_rate - 1;
+	plan->transform_size = frame_size;
+	plan->stages = 0;
+	for (int s = 0; s < PASS_DECIMATION_STAGES; s++)
+		plan->halfband[s] = NULL;
+	plan->windowed = NULL;
+	plan->decimated = NULL;
+
+	size_t samples = (size_t)(transforms) * frame_size;
+	size_t bins = (size_t)(transforms) * plan->output_rate;
+
+	/* the window is built in double either way */
+	plan->window = malloc(sizeof(double) * frame_size);
+	if (plan->window == NULL)
+		return PASS_FAILURE_NOMEM;
+
+	plan->octave_fraction = 3;
+	plan->octave_smallest = PASS_OCTAVE_BAND_SMALLEST;
+	plan->octave_bands_count = PASS_OCTAVE_BAND_LARGEST - PASS_OCTAVE_BAND_SMALLEST + 1;
+	plan->octave_bands = malloc(sizeof(pass_octave_band) * plan->octave_bands_count);
+	if (plan->octave_bands == NULL)
+		return PASS_FAILURE_NOMEM;
+	plan->weighting = PASS_WEIGHTING_Z;
+	plan->octave_weights = NULL;
+
+	hann(plan->window, frame_size);
+	octave_bands_generate(plan->octave_bands, plan->octave_fraction, plan->octave_smallest, plan->octave_bands_count, plan->bin_width);
+
+	/* transforms are frame_size apart in input and output_rate apart in result */
+	int n = frame_size;
+
+	if (flags & PASS_PLAN_SINGLE) {
+		plan->input_f = fftwf_malloc(sizeof(float) * samples);
+		if (plan->input_f == NULL)
+			return PASS_FAILURE_NOMEM;
+
+		plan->window_f = malloc(sizeof(float) * frame_size);
+		if (plan->window_f == NULL)
+			return PASS_FAILURE_NOMEM;
+
+		plan->result_f = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex) * bins);
+		if (plan->result_f == NULL)
+			return PASS_FAILURE_NOMEM;
+
+		for (int i = 0; i < frame_size; i++)
+			plan->window_f[i] = (float)(plan->window[i]);
+
+		plan->plan_forward_f = fftwf_plan_many_dft_r2c(
+			1, &n, transforms,
+			plan->input_f, NULL, 1, frame_size,
+			plan->result_f, NULL, 1, plan->output_rate,
+			planner_flags(flags));
+		if (plan->plan_forward_f == NULL)
+			return PASS_FAILURE_GENERIC;
+
+		if (flags & (PASS_PLAN_MEASURE | PASS_PLAN_PATIENT))
+			wisdom_save(true);
+
+		return PASS_SUCCESS;
+	}
+
+	plan->input = fftw_malloc(sizeof(double) * samples);
+	if (plan->input == NULL)
+		return PASS_FAILURE_NOMEM;
+
+	plan->result = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * bins);
+	if (plan->result == NULL)
+		return PASS_FAILURE_NOMEM;
+
+	plan->plan_forward = fftw_plan_many_dft_r2c(
+		1, &n, transforms,
+		plan->input, NULL, 1, frame_size,
+		plan->result, NULL, 1, plan->output_rate,
+		planner_flags(flags));
+	if (plan->plan_forward == NULL)
+		return PASS_FAILURE_GENERIC;
+
+	if (flags & (PASS_PLAN_MEASURE | PASS_PLAN_PATIENT))
+		wisdom_save(false);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_plan_init_pruned(
+	pass_fftw_plan *plan,
+	const int sample_rate,
+	const int frame_size,
+	const double lowest,
+	const double highest,
+	const int flags) {
+
+	pass_response pr;
+
+	/* an estimated full plan for its octave bands and window, the transform is replaced below */
+	pr = pass_fftw_plan_init_many(plan, sample_rate, frame_size, 1, 0);
+	return_failure_if((pr != PASS_SUCCESS), pr, "failed to init plan");
+
+	fftw_destroy_plan(plan->plan_forward);
+	fftw_free(plan->result);
+	fftw_free(plan->input);
+	plan->plan_forward = NULL;
+	plan->result = NULL;
+	plan->input = NULL;
+	plan->flags = flags;
+
+	int lower = (int)(floor(lowest / plan->bin_width));
+	int upper = (int)(ceil(highest / plan->bin_width));
+	if (lower < 0)
+		lower = 0;
+	if (upper > (frame_size / 2))
+		upper = frame_size / 2;
+	return_failure_if((lower > upper), PASS_FAILURE_GENERIC, "no bins between %.1f Hz and %.1f Hz", lowest, highest);
+
+	plan->lower = lower;
+	plan->upper = upper;
+	plan->output_rate = upper + 1;
+
+	/* halve the rate for as long as the needed bins stay clear of the halfband transition */
+	double decimate = 0.0;
+	int n = frame_size;
+	int stages = 0;
+	double transitions[PASS_DECIMATION_STAGES];
+
+	while ((stages < PASS_DECIMATION_STAGES) && ((n % 2) == 0)) {
+		double transition = ((n / 2.0) - (2.0 * (upper + PRUNE_MARGIN))) / n;
+		if (transition < PRUNE_TRANSITION)
+			break;
+
+		double taps = (PRUNE_ATTENUATION - 8.0) / (2.285 * 2.0 * M_PI * transition);
+		decimate += (n / 2.0) * (taps / 2.0 + 1.0) * 2.0;
+
+		transitions[stages++] = transition;
+		n /= 2;
+	}
+	decimate += fft_cost(n);
+
+	double full = fft_cost(frame_size);
+	double filters = 4.0 * (double)(frame_size) * (upper - lower + 1);
+
+	plan->engine = PASS_ENGINE_FFT;
+	if ((stages > 0) && (decimate < full) && (decimate <= filters))
+		plan->engine = PASS_ENGINE_DECIMATE;
+	else if (filters < full)
+		plan->engine = PASS_ENGINE_GOERTZEL;
+
+	plan->windowed = malloc(sizeof(double) * frame_size);
+	plan->decimated = malloc(sizeof(double) * (frame_size - (frame_size / 4)));
+	return_failure_if((plan->windowed == NULL) || (plan->decimated == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	if (plan->engine == PASS_ENGINE_GOERTZEL) {
+		plan->transform_size = 0;
+		return PASS_SUCCESS;
+	}
+
+	if (plan->engine == PASS_ENGINE_DECIMATE) {
+		for (int s = 0; s < stages; s++) {
+			plan->halfband[s] = malloc(sizeof(double) * halfband_count(transitions[s]));
+			return_failure_if((plan->halfband[s] == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+			plan->halfband_count[s] = halfband_design(plan->halfband[s], transitions[s]);
+			plan->stages = s + 1;
+		}
+	} else {
+		n = frame_size;
+	}
+
+	plan->transform_size = n;
+
+	plan->input = fftw_malloc(sizeof(double) * n);
+	plan->result = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * ((n / 2) + 1));
+	return_failure_if((plan->input == NULL) || (plan->result == NULL), PASS_FAILURE_NOMEM, "fftw_malloc() failed");
+
+	plan->plan_forward = fftw_plan_dft_r2c_1d(n, plan->input, plan->result, planner_flags(flags));
+	return_failure_if((plan->plan_forward == NULL), PASS_FAILURE_GENERIC, "failed to plan %d samples", n);
+
+	if (flags & (PASS_PLAN_MEASURE | PASS_PLAN_PATIENT))
+		wisdom_save(false);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_plan_term(pass_fftw_plan *plan)
+{
+	/* a pruned plan transforms in double whatever its arrays hold */
+	if (plan->plan_forward_f != NULL)
+		fftwf_destroy_plan(plan->plan_forward_f);
+	fftwf_free(plan->result_f);
+	fftwf_free(plan->input_f);
+	free(plan->window_f);
+
+	if (plan->plan_forward != NULL)
+		fftw_destroy_plan(plan->plan_forward);
+	fftw_free(plan->result);
+	fftw_free(plan->input);
+
+	for (int s = 0; s < plan->stages; s++)
+		free(plan->halfband[s]);
+	free(plan->windowed);
+	free(plan->decimated);
+
+	free(plan->octave_bands);
+	free(plan->octave_weights);
+	free(plan->window);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_plan_weighting(pass_fftw_plan *plan, const int weighting) {
+	return_failure_if((weighting < PASS_WEIGHTING_Z) || (weighting > PASS_WEIGHTING_C), PASS_FAILURE_GENERIC, "invalid weighting %d", weighting);
+
+	plan->weighting = weighting;
+
+	free(plan->octave_weights);
+	plan->octave_weights = NULL;
+
+	if (weighting == PASS_WEIGHTING_Z)
+		return PASS_SUCCESS;
+
+	plan->octave_weights = malloc(sizeof(double) * plan->octave_bands_count);
+	return_failure_if((plan->octave_weights == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	octave_weights_generate(plan->octave_weights, weighting, plan->octave_fraction, plan->octave_smallest, plan->octave_bands_count);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_threads(const int threads) {
+	static bool initialised = false;
+
+	if (!initialised) {
+		return_failure_if((fftw_init_threads() == 0), PASS_FAILURE_GENERIC, "fftw_init_threads() failed");
+		return_failure_if((fftwf_init_threads() == 0), PASS_FAILURE_GENERIC, "fftwf_init_threads() failed");
+		initialised = true;
+	}
+
+	fftw_plan_with_nthreads(threads);
+	fftwf_plan_with_nthreads(threads);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_fftw_wisdom(const char *path) {
+	char single[PATH_MAX];
+
+	free(wisdom_path);
+	wisdom_path = strdup(path);
+	return_failure_if((wisdom_path == NULL), PASS_FAILURE_NOMEM, "strdup() failed: %s", strerror(errno));
+
+	/* a missing file is the first run on this host, plans are measured and saved */
+	if (fftw_import_wisdom_from_filename(path) == 0)
+		info(stdout, "no wisdom loaded from %s", path);
+
+	snprintf(single, sizeof(single), "%s%s", path, WISDOM_SINGLE);
+	fftwf_import_wisdom_from_filename(single);
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_frequency_bins(const pass_array *input, pass_array *output, const int lower, const int upper, const int stride) {
+	int i, j, k;
+	double sum;
+
+	int bins = (upper > lower) ? ((upper - lower) + stride - 1) / stride : 0;
+	return_failure_if((stride < 1) || (lower < 0), PASS_FAILURE_GENERIC, "invalid bins %d to %d by %d", lower, upper, stride);
+	return_failure_if((lower + (bins * stride) > input->count), PASS_FAILURE_GENERIC, "bins reach past the spectrum");
+	return_failure_if((bins > output->total), PASS_FAILURE_NOMEM, "insufficent memory");
+	return_failure_if(((input->values_f != NULL) != (output->values_f != NULL)), PASS_FAILURE_GENERIC, "input and output precision differ");
+
+	if (input->values_f != NULL) {
+		const float *values = input->values_f;
+
+		/* sums are kept in double, wide bins would otherwise lose the small terms */
+		for (i = lower, j = 0; i < upper; i += stride, j++) {
+			sum = 0.0;
+			for (k = i; k < (i + stride); k++) {
+				sum += values[k];
+			}
+			output->values_f[j] = (float)(sum);
+		}
+		output->count = j;
+		output->sequence_id = input->sequence_id;
+
+		return PASS_SUCCESS;
+	}
+
+	for (i = lower, j = 0; i < upper; i += stride, j++) {
+		sum = 0.0;
+		for (k = i; k < (i + stride); k++) {
+			sum += input->values[k];
+		}
+		output->values[j] = sum;
+	}
+	output->count = j;
+	output->sequence_id = input->sequence_id;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_gaps_detection(pass_context *pc) {
+	/* pass_read placed a whole frame, it is handed out once */
+	if (pc->placed) {
+		pc->placed = false;
+
+		if (pc->header_size == 0)
+			return PASS_SUCCESS;
+
+		sequence_id_update(pc);
+
+		return frame_corrupt(pc) ? PASS_FAILURE_CHECKSUM : PASS_SUCCESS;
+	}
+
+	/* datagrams, shared memory, headerless and in sync reads place one frame per pass_read */
+	if ((pc->datagram != NULL) || (pc->shm != NULL) || (pc->header_size == 0) || (pc->in_sync))
+		return PASS_FAILURE_NO_DATA;
+
+	/* one frame at a time out of the ring, the caller asks again until PASS_FAILURE_NO_DATA */
+	pass_response pr = frame_next(pc);
+	if (pr != PASS_SUCCESS)
+		return pr;
+
+	pass_ring *ring = &(pc->ring);
+	if ((pc->uring == NULL) && (ring->count == 0)) {
+		/* the frame ended the ring, reads can go straight to the next header and payload from here */
+		pc->in_sync = true;
+	}
+
+	sequence_id_update(pc);
+
+	if (frame_corrupt(pc))
+		return PASS_FAILURE_CHECKSUM;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_iir_bank_execute(pass_iir_bank *bank, const pass_array *input, pass_array *output) {
+	int bands = bank->upper - bank->lower;
+	int channels = bank->channels;
+	int count = input[0].count;
+	pass_iir_level *top = &(bank->level[0]);
+
+	for (int c = 0; c < channels; c++) {
+		return_failure_if((input[c].count > bank->frame_size) || (bands > output[c].total), PASS_FAILURE_NOMEM, "insufficent memory");
+		return_failure_if((input[c].count != count), PASS_FAILURE_GENERIC, "%d samples on channel %d where channel 0 has %d", input[c].count, c, count);
+		return_failure_if(((input[c].values_f != NULL) != (output[c].values_f != NULL)), PASS_FAILURE_GENERIC, "input and output precision differ");
+	}
+
+	for (int l = 0; l < bank->levels; l++) {
+		pass_iir_level *level = &(bank->level[l]);
+		int width = (level->upper - level->lower) * channels;
+
+		for (int j = 0; j < width; j++)
+			level->squares[j] = 0.0;
+		level->squared = 0;
+	}
+
+	/* the extremes of a call start from where its levels stand */
+	for (int j = 0; j < bands * channels; j++)
+		bank->highest[j] = bank->lowest[j] = bank->values[j];
+
+	for (int start = 0; start < count; start += IIR_BLOCK) {
+		int block = (count - start < IIR_BLOCK) ? count - start : IIR_BLOCK;
+
+		for (int i = 0; i < block; i++) {
+			double *x = top->samples + (i * channels);
+			for (int c = 0; c < channels; c++)
+				x[c] = (input[c].values_f != NULL) ? (double)(input[c].values_f[start + i]) : input[c].values[start + i];
+		}
+		top->count = block;
+
+		for (int l = 0; l < bank->levels; l++) {
+			pass_iir_level *level = &(bank->level[l]);
+
+			if (l + 1 < bank->levels) {
+				pass_iir_level *next = &(bank->level[l + 1]);
+				next->count = halfband_stream(level->halfband, level->halfband_count, channels, level->history, &(level->history_count), level->samples, level->count, next->samples);
+			}
+
+			if (level->upper > level->lower) {
+				int offset = (level->lower - bank->lower) * channels;
+				iir_level_run(level, channels, bank->values + offset, bank->highest + offset, bank->lowest + offset);
+			}
+		}
+	}
+
+	/* a call too short to reach a level leaves its bands as they were */
+	for (int l = 0; l < bank->levels; l++) {
+		pass_iir_level *level = &(bank->level[l]);
+		int width = (level->upper - level->lower) * channels;
+		int offset = (level->lower - bank->lower) * channels;
+
+		for (int j = 0; (level->squared > 0) && (j < width); j++) {
+			bank->mean_squares[offset + j] = level->squares[j] / level->squared;
+			if (bank->time_constant == 0.0)
+				bank->values[offset + j] = bank->highest[offset + j] = bank->lowest[offset + j] = bank->mean_squares[offset + j];
+		}
+	}
+
+	for (int c = 0; c < channels; c++) {
+		for (int b = 0; b < bands; b++) {
+			double value = bank->values[(b * channels) + c];
+			if (bank->weights != NULL)
+				value *= bank->weights[b];
+
+			if (output[c].values_f != NULL)
+				output[c].values_f[b] = (float)(value);
+			else
+				output[c].values[b] = value;
+		}
+		output[c].count = bands;
+		output[c].sequence_id = input[c].sequence_id;
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_iir_bank_extremes(pass_iir_bank *bank, const int channel, pass_array *mean_square, pass_array *highest, pass_array *lowest) {
+	int bands = bank->upper - bank->lower;
+
+	return_failure_if((channel < 0) || (channel >= bank->channels), PASS_FAILURE_GENERIC, "invalid channel %d of %d", channel, bank->channels);
+	return_failure_if((bands > mean_square->total) || (bands > highest->total) || (bands > lowest->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	pass_array *outputs[3] = { mean_square, highest, lowest };
+	const double *sources[3] = { bank->mean_squares, bank->highest, bank->lowest };
+
+	for (int n = 0; n < 3; n++) {
+		for (int b = 0; b < bands; b++) {
+			double value = sources[n][(b * bank->channels) + channel];
+			if (bank->weights != NULL)
+				value *= bank->weights[b];
+
+			if (outputs[n]->values_f != NULL)
+				outputs[n]->values_f[b] = (float)(value);
+			else
+				outputs[n]->values[b] = value;
+		}
+		outputs[n]->count = bands;
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_iir_bank_init(
+	pass_iir_bank *bank,
+	const int sample_rate,
+	const int frame_size,
+	const int channels,
+	const int lower,
+	const int upper,
+	const double time_constant,
+	const int weighting) {
+
+	return_failure_if((lower < PASS_OCTAVE_BAND_SMALLEST) || (upper > PASS_OCTAVE_BAND_LARGEST + 1) || (lower >= upper), PASS_FAILURE_GENERIC, "invalid bands %d to %d", lower, upper);
+	return_failure_if((octave_band_edge(3, upper - 1, 1) >= sample_rate / 2.0), PASS_FAILURE_GENERIC, "band %d reaches past half the sample rate", upper - 1);
+	return_failure_if((frame_size < 1) || (channels < 1) || (time_constant < 0.0), PASS_FAILURE_GENERIC, "invalid frame size %d, %d channels or time constant %f", frame_size, channels, time_constant);
+	return_failure_if((weighting < PASS_WEIGHTING_Z) || (weighting > PASS_WEIGHTING_C), PASS_FAILURE_GENERIC, "invalid weighting %d", weighting);
+
+	int bands = upper - lower;
+	int band_level[bands];
+
+	/* each band goes to the deepest level whose passband still holds it */
+	int levels = 1;
+	for (int n = lower; n < upper; n++) {
+		double edge = octave_band_edge(3, n, 1);
+
+		int l = 0;
+		while (edge <= IIR_PASSBAND * ldexp(sample_rate, -(l + 1)))
+			l++;
+
+		band_level[n - lower] = l;
+		if (l + 1 > levels)
+			levels = l + 1;
+	}
+
+	bank->lower = lower;
+	bank->upper = upper;
+	bank->time_constant = time_constant;
+	bank->frame_size = frame_size;
+	bank->channels = channels;
+	bank->levels = levels;
+
+	bank->values = calloc(bands * channels, sizeof(double));
+	bank->mean_squares = calloc(bands * channels, sizeof(double));
+	bank->highest = calloc(bands * channels, sizeof(double));
+	bank->lowest = calloc(bands * channels, sizeof(double));
+	bank->level = calloc(levels, sizeof(pass_iir_level));
+	return_failure_if((bank->values == NULL) || (bank->mean_squares == NULL) || (bank->highest == NULL) || (bank->lowest == NULL) || (bank->level == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+
+	bank->weights = NULL;
+	if (weighting != PASS_WEIGHTING_Z) {
+		bank->weights = malloc(sizeof(double) * bands);
+		return_failure_if((bank->weights == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+		octave_weights_generate(bank->weights, weighting, 3, lower, bands);
+	}
+
+	int capacity = (frame_size < IIR_BLOCK) ? frame_size : IIR_BLOCK;
+
+	for (int l = 0; l < levels; l++) {
+		pass_iir_level *level = &(bank->level[l]);
+
+		level->sample_rate = ldexp(sample_rate, -l);
+		level->lower = lower;
+		level->upper = lower;
+
+		int highest = lower;
+		for (int n = upper - 1; n >= lower; n--) {
+			if (band_level[n - lower] > l) {
+				highest = n;
+				break;
+			}
+			if (band_level[n - lower] == l) {
+				if (level->upper == level->lower)
+					level->upper = n + 1;
+				level->lower = n;
+			}
+		}
+
+		if (l + 1 < levels) {
+			double transition = 0.5 - (2.0 * octave_band_edge(3, highest, 1) / level->sample_rate);
+
+			level->halfband_count = halfband_count(transition);
+			level->halfband = malloc(sizeof(double) * level->halfband_count);
+			return_failure_if((level->halfband == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+			halfband_design(level->halfband, transition);
+
+			int reach = (2 * level->halfband_count) - 1;
+			level->history = calloc(((2 * reach) + 2 + capacity) * channels, sizeof(double));
+			return_failure_if((level->history == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+			level->history_count = reach;
+		}
+
+		level->samples = malloc(sizeof(double) * capacity * channels);
+		return_failure_if((level->samples == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+		level->count = 0;
+
+		int level_bands = level->upper - level->lower;
+		if (level_bands > 0) {
+			int width = level_bands * channels;
+			int coefficients = PASS_IIR_SECTIONS * width;
+
+			level->weight = (time_constant > 0.0) ? 1.0 - exp(-1.0 / (time_constant * level->sample_rate)) : 0.0;
+			level->gain = malloc(sizeof(double) * coefficients);
+			level->a1 = malloc(sizeof(double) * coefficients);
+			level->a2 = malloc(sizeof(double) * coefficients);
+			level->z1 = calloc(coefficients, sizeof(double));
+			level->z2 = calloc(coefficients, sizeof(double));
+			level->output = malloc(sizeof(double) * width);
+			level->squares = malloc(sizeof(double) * width);
+			return_failure_if((level->gain == NULL) || (level->a1 == NULL) || (level->a2 == NULL) || (level->z1 == NULL) || (level->z2 == NULL) || (level->output == NULL) || (level->squares == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+			/* designed once into the first channel, every channel filters with the same sections */
+			for (int b = 0; b < level_bands; b++) {
+				int n = level->lower + b;
+				iir_band_design(level->gain + (b * channels), level->a1 + (b * channels), level->a2 + (b * channels), width, level->sample_rate, octave_band_edge(3, n, -1), octave_band_edge(3, n, 1));
+			}
+
+			for (int j = 0; j < coefficients; j += channels) {
+				for (int k = 1; k < channels; k++) {
+					level->gain[j + k] = level->gain[j];
+					level->a1[j + k] = level->a1[j];
+					level->a2[j + k] = level->a2[j];
+				}
+			}
+		}
+
+		capacity = (capacity / 2) + 2;
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_iir_bank_term(pass_iir_bank *bank) {
+	for (int l = 0; l < bank->levels; l++) {
+		pass_iir_level *level = &(bank->level[l]);
+
+		free(level->halfband);
+		free(level->history);
+		free(level->samples);
+		free(level->gain);
+		free(level->a1);
+		free(level->a2);
+		free(level->z1);
+		free(level->z2);
+		free(level->output);
+		free(level->squares);
+	}
+
+	free(bank->level);
+	free(bank->values);
+	free(bank->mean_squares);
+	free(bank->highest);
+	free(bank->lowest);
+	free(bank->weights);
+
+	bank->level = NULL;
+	bank->values = NULL;
+	bank->mean_squares = NULL;
+	bank->highest = NULL;
+	bank->lowest = NULL;
+	bank->weights = NULL;
+
+	return PASS_SUCCESS;
+}
+
+/* highest and lowest NULL time weight the input here, otherwise the source has weighted it and kept the extremes */
+static pass_response meter_accumulate(pass_meter *meter, const pass_array *input, const pass_array *highest, const pass_array *lowest, const double seconds) {
+	return_failure_if((input->count > meter->total), PASS_FAILURE_NOMEM, "insufficent memory");
+	return_failure_if((meter->elapsed > 0.0) && (input->count != meter->count), PASS_FAILURE_GENERIC, "%d values where the interval has %d", input->count, meter->count);
+	return_failure_if((highest != NULL) && ((highest->count != input->count) || (lowest->count != input->count)), PASS_FAILURE_GENERIC, "extremes of %d and %d values for %d", highest->count, lowest->count, input->count);
+
+	/* an interval starts with the highest and lowest of its first input */
+	bool start = (meter->elapsed == 0.0);
+	meter->count = input->count;
+
+	double weight = (meter->time_constant > 0.0) ? 1.0 - exp(-seconds / meter->time_constant) : 1.0;
+	if (!meter->primed)
+		weight = 1.0;
+	meter->primed = true;
+
+	for (int i = 0; i < meter->count; i++) {
+		double value = (input->values_f != NULL) ? (double)(input->values_f[i]) : input->values[i];
+
+		meter->energy[i] += value * seconds;
+
+		double high, low;
+		if (highest != NULL) {
+			high = (highest->values_f != NULL) ? (double)(highest->values_f[i]) : highest->values[i];
+			low = (lowest->values_f != NULL) ? (double)(lowest->values_f[i]) : lowest->values[i];
+		} else {
+			meter->running[i] += weight * (value - meter->running[i]);
+			high = low = meter->running[i];
+		}
+
+		if (start || (high > meter->highest[i]))
+			meter->highest[i] = high;
+		if (start || (low < meter->lowest[i]))
+			meter->lowest[i] = low;
+	}
+	meter->elapsed += seconds;
+
+	/* frames seldom add up to the interval exactly, the summary closes on the one that reaches it */
+	if (meter->elapsed < meter->interval * (1.0 - 1e-9))
+		return PASS_FAILURE_NO_DATA;
+
+	for (int i = 0; i < meter->count; i++) {
+		meter->leq.values[i] = meter->energy[i] / meter->elapsed;
+		meter->lmax.values[i] = meter->highest[i];
+		meter->lmin.values[i] = meter->lowest[i];
+
+		meter->energy[i] = 0.0;
+	}
+	meter->leq.count = meter->lmax.count = meter->lmin.count = meter->count;
+	meter->leq.sequence_id = meter->lmax.sequence_id = meter->lmin.sequence_id = input->sequence_id;
+
+	meter->elapsed = 0.0;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_meter_execute(pass_meter *meter, const pass_array *input, const double seconds) {
+	return meter_accumulate(meter, input, NULL, NULL, seconds);
+}
+
+pass_response pass_meter_execute_weighted(pass_meter *meter, const pass_array *input, const pass_array *highest, const pass_array *lowest, const double seconds) {
+	return_failure_if((highest == NULL) || (lowest == NULL), PASS_FAILURE_GENERIC, "no extremes");
+
+	return meter_accumulate(meter, input, highest, lowest, seconds);
+}
+
+pass_response pass_meter_init(pass_meter *meter, const int total, const double interval, const double time_constant) {
+	pass_response pr;
+
+	return_failure_if((total < 1) || (interval < 0.0) || (time_constant < 0.0), PASS_FAILURE_GENERIC, "invalid meter of %d values, interval %f, time constant %f", total, interval, time_constant);
+
+	meter->count = 0;
+	meter->total = total;
+	meter->interval = interval;
+	meter->time_constant = time_constant;
+	meter->elapsed = 0.0;
+	meter->primed = false;
+
+	meter->energy = calloc(total, sizeof(double));
+	meter->running = calloc(total, sizeof(double));
+	meter->highest = calloc(total, sizeof(double));
+	meter->lowest = calloc(total, sizeof(double));
+	return_failure_if((meter->energy == NULL) || (meter->running == NULL) || (meter->highest == NULL) || (meter->lowest == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+
+	pr = pass_array_allocate(&(meter->leq), total);
+	return_failure_if((pr != PASS_SUCCESS), pr, "failed to allocate memory");
+	pr = pass_array_allocate(&(meter->lmax), total);
+	return_failure_if((pr != PASS_SUCCESS), pr, "failed to allocate memory");
+	pr = pass_array_allocate(&(meter->lmin), total);
+	return_failure_if((pr != PASS_SUCCESS), pr, "failed to allocate memory");
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_meter_term(pass_meter *meter) {
+	free(meter->energy);
+	free(meter->running);
+	free(meter->highest);
+	free(meter->lowest);
+
+	meter->energy = NULL;
+	meter->running = NULL;
+	meter->highest = NULL;
+	meter->lowest = NULL;
+
+	pass_array_free(&(meter->leq));
+	pass_array_free(&(meter->lmax));
+	pass_array_free(&(meter->lmin));
+
+	return PASS_SUCCESS;
+}
+
+int pass_octave_band_number(const int fraction, const double frequency) {
+	double d = ((fraction % 2) == 0) ? 1.5 : 0.0;
+
+	return (int)(lround(((10.0 * fraction * log10(frequency)) - d) / 3.0));
+}
+
+pass_response pass_octave_bank_execute(pass_octave_bank *bank, const pass_array *input, pass_array *output) {
+	int bands = bank->upper - bank->lower;
+	pass_octave_level *top = &(bank->level[0]);
+
+	return_failure_if((input->values == NULL) || (output->values == NULL), PASS_FAILURE_GENERIC, "octave bank is double precision");
+	return_failure_if((input->count > top->samples.total) || (bands > output->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	memcpy(top->samples.values, input->values, sizeof(double) * input->count);
+	top->samples.count = input->count;
+
+	bool complete = true;
+
+	for (int l = 0; l < bank->levels; l++) {
+		pass_octave_level *level = &(bank->level[l]);
+
+		/* the next level takes its samples before the transform overwrites them */
+		if (l + 1 < bank->levels) {
+			pass_array *next = &(bank->level[l + 1].samples);
+			next->count = halfband_stream(level->halfband, level->halfband_count, 1, level->history, &(level->history_count), level->samples.values, level->samples.count, next->values);
+		}
+
+		if (level->upper == level->lower)
+			continue;
+
+		if (pass_welch_execute(&(level->welch), &(level->samples), &(level->plan)) == PASS_SUCCESS) {
+			/* the level's bands go straight to their place among the bank's */
+			pass_array view = {
+				.count = 0,
+				.total = level->upper - level->lower,
+				.values = bank->values + (level->lower - bank->lower),
+				.values_f = NULL,
+			};
+			pass_octave_bands(&(level->samples), &view, &(level->plan), level->lower, level->upper);
+
+			level->estimated = true;
+		}
+
+		complete = complete && level->estimated;
+	}
+
+	memcpy(output->values, bank->values, sizeof(double) * bands);
+	output->count = bands;
+	output->sequence_id = input->sequence_id;
+
+	return complete ? PASS_SUCCESS : PASS_FAILURE_NO_DATA;
+}
+
+pass_response pass_octave_bank_init(
+	pass_octave_bank *bank,
+	const int sample_rate,
+	const int frame_size,
+	const int lower,
+	const int upper,
+	const int weighting) {
+
+	pass_response pr;
+
+	return_failure_if((lower < PASS_OCTAVE_BAND_SMALLEST) || (upper > PASS_OCTAVE_BAND_LARGEST + 1) || (lower >= upper), PASS_FAILURE_GENERIC, "invalid bands %d to %d", lower, upper);
+	return_failure_if((weighting < PASS_WEIGHTING_Z) || (weighting > PASS_WEIGHTING_C), PASS_FAILURE_GENERIC, "invalid weighting %d", weighting);
+
+	int bands = upper - lower;
+	int band_level[bands];
+
+	/* each band goes to the deepest level whose passband still holds it */
+	int levels = 1;
+	for (int n = lower; n < upper; n++) {
+		double edge = octave_band_edge(3, n, 1);
+
+		int l = 0;
+		while (edge <= BANK_PASSBAND * ldexp(sample_rate, -(l + 1)))
+			l++;
+
+		band_level[n - lower] = l;
+		if (l + 1 > levels)
+			levels = l + 1;
+	}
+
+	bank->lower = lower;
+	bank->upper = upper;
+	bank->levels = levels;
+
+	bank->values = calloc(bands, sizeof(double));
+	bank->level = calloc(levels, sizeof(pass_octave_level));
+	return_failure_if((bank->values == NULL) || (bank->level == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+
+	int capacity = frame_size;
 
-	if (pc->sd >= 0)
-		close(pc->sd);
-	pc->sd = -1;
+	for (int l = 0; l < levels; l++) {
+		pass_octave_level *level = &(bank->level[l]);
 
-	if (pc->input) {
-		free(pc->input);
-		pc->input = NULL;
-	}
+		level->sample_rate = ldexp(sample_rate, -l);
+		level->lower = lower;
+		level->upper = lower;
 
-	if (pc->scratch.buffer != NULL) {
-		free(pc->scratch.buffer);
-		pc->scratch.buffer = NULL;
+		/* deeper levels hold the lower bands, the bands of a level follow each other */
+		int highest = lower;
+		for (int n = upper - 1; n >= lower; n--) {
+			if (band_level[n - lower] > l) {
+				highest = n;
+				break;
+			}
+			if (band_level[n - lower] == l) {
+				if (level->upper == level->lower)
+					level->upper = n + 1;
+				level->lower = n;
+			}
+		}
 
-		pc->scratch.count = 0;
-		pc->scratch.total = 0;
-	}
+		/* the halfband only has to keep the highest band of the levels below clear of aliases */
+		if (l + 1 < levels) {
+			double transition = 0.5 - (2.0 * octave_band_edge(3, highest, 1) / level->sample_rate);
 
-	if (pc->payload != NULL) {
-		free(pc->payload);
-		pc->payload = NULL;
-	}
-	if (pc->header != NULL) {
-		free(pc->header);
-		pc->header = NULL;
-	}
-		
-	return PASS_SUCCESS;
-}
+			level->halfband_count = halfband_count(transition);
+			level->halfband = malloc(sizeof(double) * level->halfband_count);
+			return_failure_if((level->halfband == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+			halfband_design(level->halfband, transition);
 
-pass_response pass_context_init(
-	pass_context *pc,
-	int sensor_count,
-	int channel_count,
-	int sample_rate,
-	bool contains_header) {
+			int reach = (2 * level->halfband_count) - 1;
+			level->history = calloc((2 * reach) + 2 + capacity, sizeof(double));
+			return_failure_if((level->history == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
+			level->history_count = reach;
+		}
 
-	if (pc == NULL) {
-		pc = malloc(sizeof(pass_context));
-		return_failure_if((pc == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
-	}
-	memset(pc, 0, sizeof(pass_context));
+		int total = capacity;
 
-	pc->sequence_id = 0;
-	pc->sensor_count = sensor_count;
-	pc->channel_count = channel_count;
-	pc->sample_rate = sample_rate;
+		if (level->upper > level->lower) {
+			/* enough bins across the narrowest band, the lowest of the level */
+			double width = octave_band_edge(3, level->lower, 1) - octave_band_edge(3, level->lower, -1);
+			int segment = BANK_SEGMENT;
+			while (segment < BANK_BINS * level->sample_rate / width)
+				segment *= 2;
 
-	pc->header_size = 0;
-	if (contains_header)
-		pc->header_size = 42;
+			pr = pass_fftw_plan_init(&(level->plan), (int)(lround(level->sample_rate)), segment, 0);
+			return_failure_if((pr != PASS_SUCCESS), pr, "failed to init plan");
 
-	pc->sd = -1;
+			/* the rate below the top level need not be whole */
+			level->plan.bin_width = level->sample_rate / segment;
+			octave_bands_centred(level->plan.octave_bands, level->plan.octave_fraction, level->plan.octave_smallest, level->plan.octave_bands_count, level->plan.bin_width);
 
-	pc->input          = NULL;
-	pc->scratch.buffer = NULL;
-	pc->payload        = NULL;
-	pc->header         = NULL;
+			pr = pass_fftw_plan_weighting(&(level->plan), weighting);
+			return_failure_if((pr != PASS_SUCCESS), pr, "failed to weight bands");
 
-	int buffer_size = 0;
-	int samples_total = pc->sample_rate * pc->channel_count * pc->sensor_count;
+			/* levels slower than a frame overlap more, so they still update about once a frame */
+			int hop = (segment <= capacity) ? segment / 2 : segment / 4;
+			int averages = (capacity / hop > 1) ? capacity / hop : 1;
+			pr = pass_welch_init(&(level->welch), segment, hop, averages);
+			return_failure_if((pr != PASS_SUCCESS), pr, "failed to init welch averaging");
 
-	// alloc input
-	buffer_size = (sizeof(short) * samples_total) + pc->header_size;
-	pc->input = malloc(buffer_size);
-	return_failure_if((pc->input == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
-	memset(pc->input, '\0', buffer_size);
+			if (total < level->plan.output_rate)
+				total = level->plan.output_rate;
+		}
 
-	// alloc scratch
-	buffer_size = 2 * ((sizeof(short) * samples_total) + pc->header_size);
-	pc->scratch.buffer = malloc(buffer_size);
-	return_failure_if((pc->scratch.buffer == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
-	memset(pc->scratch.buffer, '\0', buffer_size);
-	pc->scratch.count = 0;
-	pc->scratch.total = buffer_size;
-
-	// alloc payload
-	buffer_size = sizeof(short) * samples_total;
-	pc->payload = malloc(buffer_size);
-	return_failure_if((pc->payload == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
-	memset(pc->payload, '\0', buffer_size);
-
-	// alloc header
-	if (contains_header) {
-		buffer_size = pc->header_size;
-		pc->header = malloc(buffer_size);
-		return_failure_if((pc->header == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
-		memset(pc->header, '\0', buffer_size);
+		pr = pass_array_allocate(&(level->samples), total);
+		return_failure_if((pr != PASS_SUCCESS), pr, "failed to allocate memory");
+
+		capacity = (capacity / 2) + 2;
 	}
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_convert_to_doubles(
-	pass_array *array,
-	const pass_context *pc,
-	const int sensor,
-	const int channel,
-	const double gradient,
-	const double offset) {
-
-	return_failure_if((pc->sample_rate > array->total), PASS_FAILURE_NOMEM, "insufficent memory");
-
-	int count = pc->sensor_count * pc->channel_count * pc->sample_rate;
+pass_response pass_octave_bank_term(pass_octave_bank *bank) {
+	for (int l = 0; l < bank->levels; l++) {
+		pass_octave_level *level = &(bank->level[l]);
 
-	int i = 0;
-	for (int c = 0; c < count; c += (pc->sensor_count * pc->channel_count)) {
-		int l = c + (sensor * pc->channel_count) + channel;
-		short s = pc->payload[l];
+		if (level->upper > level->lower) {
+			pass_fftw_plan_term(&(level->plan));
+			pass_welch_term(&(level->welch));
+		}
 
-		array->values[i] = ((double)(s)) * gradient + offset;
-		i++;
+		pass_array_free(&(level->samples));
+		free(level->halfband);
+		free(level->history);
 	}
 
-	array->count = i;
-	array->sequence_id = pc->sequence_id;
+	free(bank->level);
+	free(bank->values);
+
+	bank->level = NULL;
+	bank->values = NULL;
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_curl_init()
-{
-	CURLcode cr;
-	cr = curl_global_init(CURL_GLOBAL_ALL);
-	if (cr != CURLE_OK)
-		return PASS_FAILURE_CURL;
+pass_response pass_octave_bands(const pass_array *input, pass_array *output, const pass_fftw_plan *plan, const int lower, const int upper) {
+	int index_lower, index_upper;
 
-	return PASS_SUCCESS;
-}
+	index_lower = (lower <= plan->octave_smallest) ? 0 : lower - plan->octave_smallest;
+	index_upper = (upper - plan->octave_smallest >= plan->octave_bands_count) ? plan->octave_bands_count : upper - plan->octave_smallest;
 
-pass_response pass_curl_post(
-	const char *url,
-	const pass_array *input,
-	const char *name,
-	const char *msg_type,
-	const int sensor,
-	const int channel) {
+	/* bands reaching past the last bin are left out */
+	while ((index_upper > index_lower) && (plan->octave_bands[index_upper - 1].upper >= input->count)) {
+		index_upper--;
+	}
 
-	CURL *curl;
-	CURLcode cr;
-	struct curl_slist *headers = NULL;
+	return_failure_if((index_upper - index_lower > output->total), PASS_FAILURE_NOMEM, "insufficent memory");
+	return_failure_if(((input->values_f != NULL) != (output->values_f != NULL)), PASS_FAILURE_GENERIC, "input and output precision differ");
 
-	json_object *jobject = json_object_new_object();
+	const pass_octave_band *bands = plan->octave_bands;
+	const double *weights = plan->octave_weights;   // NULL unweighted
 
-	json_object *jstring = json_object_new_string(name);
-	json_object *jmsg_type = json_object_new_string(msg_type);
-	json_object *jsensor = json_object_new_int(sensor);
-	json_object *jchannel = json_object_new_int(channel);
+	int i = 0;
+	double sum;
 
-	json_object *jarray = json_object_new_array();
-	for (int i = 0; i < input->count; i++) {
-		json_object *jdouble = json_object_new_double(input->values[i]);
-		json_object_array_add(jarray, jdouble);
-	}
+	if (input->values_f != NULL) {
+		const float *values = input->values_f;
 
-	json_object_object_add(jobject, "name", jstring);
-	json_object_object_add(jobject, "type", jmsg_type);
-	json_object_object_add(jobject, "sensor", jsensor);
-	json_object_object_add(jobject, "channel", jchannel);
-	json_object_object_add(jobject, "values", jarray);
+		/* band sums are kept in double, the upper bands cover many thousand bins */
+		for (int j = index_lower; j < index_upper; j++) {
+			sum = bands[j].lower_weight * values[ bands[j].lower ];
+			for (int k = (bands[j].lower + 1); k < bands[j].upper; k++) {
+				sum += values[k];
+			}
+			sum += bands[j].upper_weight * values[ bands[j].upper ];
 
-	curl = curl_easy_init();
-	if (curl == NULL)
-		return PASS_FAILURE_CURL;
+			if (weights != NULL)
+				sum *= weights[j];
 
-	headers = curl_slist_append(headers, "Accept: application/json");
-	headers = curl_slist_append(headers, "Content-Type: application/json");
-	headers = curl_slist_append(headers, "charsets: utf-8");
+			output->values_f[i] = (float)(sum);
+			i++;
+		}
+		output->count = i;
+		output->sequence_id = input->sequence_id;
 
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(jobject));
+		return PASS_SUCCESS;
+	}
 
-	cr = curl_easy_perform(curl);
-	if (cr != CURLE_OK)
-		return PASS_FAILURE_CURL;
+	for (int j = index_lower; j < index_upper; j++) {
+		sum = bands[j].lower_weight * input->values[ bands[j].lower ];
+		for (int k = (bands[j].lower + 1); k < bands[j].upper; k++) {
+			sum += input->values[k];
+		}
+		sum += bands[j].upper_weight * input->values[ bands[j].upper ];
 
-	curl_easy_cleanup(curl);
-	curl_slist_free_all(headers);
+		if (weights != NULL)
+			sum *= weights[j];
 
-	json_object_put(jobject);
+		output->values[i] = sum;
+		i++;
+	}
+	output->count = i;
+	output->sequence_id = input->sequence_id;
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_curl_term()
-{
-	curl_global_cleanup();
-	return PASS_SUCCESS;
-}
+pass_response pass_pool_init(pass_pool *pool, const int workers) {
+	return_failure_if((workers < 1), PASS_FAILURE_GENERIC, "a pool needs at least one worker");
 
-void pass_decibels(pass_array *input, const double reference, const double correction) {
-	for (int i = 0; i < input->count; i++) {
-		input->values[i] = 10.0 * log10(input->values[i] / reference) + correction;
-	}
-}
+	pool->workers = workers;
+	pool->task = NULL;
+	pool->user_data = NULL;
+	pool->count = 0;
+	pool->next = 0;
+	pool->completed = 0;
+	pool->batch = 0;
+	pool->stop = false;
 
-pass_response pass_endian_swap(pass_context *pc) {
-	int count = pc->sensor_count * pc->channel_count * pc->sample_rate;
-	short *buffer = pc->payload;
+	pthread_mutex_init(&(pool->lock), NULL);
+	pthread_cond_init(&(pool->ready), NULL);
+	pthread_cond_init(&(pool->finished), NULL);
 
-	for (int i = 0; i < count; i++) {
-		buffer[i] = bswap_16(buffer[i]);
+	pool->threads = malloc(sizeof(pthread_t) * workers);
+	return_failure_if((pool->threads == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+	for (int i = 1; i < workers; i++) {
+		struct pool_start *start = malloc(sizeof(struct pool_start));
+		return_failure_if((start == NULL), PASS_FAILURE_NOMEM, "malloc() failed: %s", strerror(errno));
+
+		start->pool = pool;
+		start->worker = i;
+
+		int r = pthread_create(&(pool->threads[i - 1]), NULL, pool_worker, start);
+		if (r != 0) {
+			free(start);
+			pool->workers = i;
+			pass_pool_term(pool);
+
+			return_failure_if(true, PASS_FAILURE_GENERIC, "pthread_create() failed: %s", strerror(r));
+		}
 	}
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_fftw_execute(pass_array *array, pass_fftw_plan *plan) {
-	// TODO: check bounds
+pass_response pass_pool_run(pass_pool *pool, pass_pool_task task, void *user_data, const int count) {
+	if (count <= 0)
+		return PASS_SUCCESS;
 
-	for (int i = 0; i < plan->sample_rate; i++) {
-		plan->input[i] = array->values[i] * plan->window[i];
+	if (pool->workers == 1) {
+		for (int i = 0; i < count; i++)
+			task(user_data, i, 0);
+
+		return PASS_SUCCESS;
 	}
 
-	fftw_execute(plan->plan_forward);
+	pthread_mutex_lock(&(pool->lock));
+	pool->task = task;
+	pool->user_data = user_data;
+	pool->count = count;
+	pool->next = 0;
+	pool->completed = 0;
+	pool->batch++;
+	pthread_cond_broadcast(&(pool->ready));
+	pthread_mutex_unlock(&(pool->lock));
 
-	array->values[0] = plan->result[0][0] * plan->result[0][0];
-	for (int i = 1; i < plan->output_rate; i++) {
-		array->values[i] = 2.0 * (plan->result[i][0] * plan->result[i][0] + plan->result[i][1] * plan->result[i][1]);
-	}
-	array->count = plan->output_rate;
+	pool_drain(pool, 0);
 
-	for (int i = array->count; i < array->total; i++) {
-		array->values[i] = 0.0;
-	}
+	pthread_mutex_lock(&(pool->lock));
+	while (pool->completed < pool->count)
+		pthread_cond_wait(&(pool->finished), &(pool->lock));
+	pthread_mutex_unlock(&(pool->lock));
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_fftw_plan_init(pass_fftw_plan *plan, const int sample_rate)
-{
-	plan->sample_rate = sample_rate;
-	plan->output_rate = (sample_rate / 2) + 1;
-	plan->input = malloc(sizeof(double) * sample_rate);
-	if (plan->input == NULL)
-		return PASS_FAILURE_NOMEM;
+pass_response pass_pool_term(pass_pool *pool) {
+	pthread_mutex_lock(&(pool->lock));
+	pool->stop = true;
+	pthread_cond_broadcast(&(pool->ready));
+	pthread_mutex_unlock(&(pool->lock));
 
-	plan->window = malloc(sizeof(double) * sample_rate);
-	if (plan->window == NULL)
-		return PASS_FAILURE_NOMEM;
+	for (int i = 1; i < pool->workers; i++)
+		pthread_join(pool->threads[i - 1], NULL);
 
-	plan->result = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * sample_rate);
-	if (plan->result == NULL)
-		return PASS_FAILURE_NOMEM;
+	free(pool->threads);
+	pool->threads = NULL;
 
-	plan->plan_forward = fftw_plan_dft_r2c_1d(sample_rate, plan->input, plan->result, FFTW_ESTIMATE);
-	hann(plan->window, sample_rate);
+	pthread_cond_destroy(&(pool->finished));
+	pthread_cond_destroy(&(pool->ready));
+	pthread_mutex_destroy(&(pool->lock));
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_fftw_plan_term(pass_fftw_plan *plan)
-{
-	fftw_destroy_plan(plan->plan_forward);
-	fftw_free(plan->result);
-	free(plan->window);
-	free(plan->input);
+pass_response pass_reactor_add(
+	pass_reactor *reactor,
+	pass_context *pc,
+	pass_frame_callback callback,
+	void *user_data) {
 
-	return PASS_SUCCESS;
-}
+	int rc;
 
-pass_response pass_frequency_bins(pass_array *input, const int lower, const int upper, const int stride) {
-	// TODO: check bounds
+	return_failure_if((reactor->count == reactor->total), PASS_FAILURE_NOMEM, "reactor full: %d streams", reactor->total);
+	return_failure_if((pc->sd < 0), PASS_FAILURE_NO_CONN, "context not connected");
+	return_failure_if((pc->uring != NULL), PASS_FAILURE_GENERIC, "context reads through io_uring");
+	return_failure_if((pc->datagram != NULL), PASS_FAILURE_GENERIC, "context receives datagrams");
+	return_failure_if((pc->shm != NULL), PASS_FAILURE_GENERIC, "context reads shared memory");
 
-	int i, j, k;
-	double sum;
+	int flags = fcntl(pc->sd, F_GETFL, 0);
+	return_failure_if((flags < 0), PASS_FAILURE_GENERIC, "fcntl() failed: %s", strerror(errno));
 
-	for (i = lower, j = 0; i < upper; i += stride, j++) {
-		sum = 0.0;
-		for (k = i; k < (i + stride); k++) {
-			sum += (input->values[k] * input->values[k]);
-		}
-		input->values[j] = sum;
-	}
-	input->count = j;
+	rc = fcntl(pc->sd, F_SETFL, flags | O_NONBLOCK);
+	return_failure_if((rc < 0), PASS_FAILURE_GENERIC, "fcntl() failed: %s", strerror(errno));
 
-	for (i = input->count; i < input->total; i++) {
-		input->values[i] = 0.0;
-	}
+	/* the reactor frames out of the ring, which is empty while in sync */
+	pc->in_sync = false;
+
+	pass_reactor_stream *stream = &(reactor->streams[reactor->count]);
+	stream->pc = pc;
+	stream->callback = callback;
+	stream->user_data = user_data;
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = stream;
+
+	rc = epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, pc->sd, &event);
+	return_failure_if((rc < 0), PASS_FAILURE_GENERIC, "epoll_ctl() failed: %s", strerror(errno));
+
+	reactor->count++;
+	reactor->active++;
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_gaps_detection(pass_context *pc) {
-	int header_first_start = 0;
-	int header_first_end = 0;
-	int header_second_start = 0;
+pass_response pass_reactor_init(pass_reactor *reactor, const int total) {
+	memset(reactor, 0, sizeof(pass_reactor));
 
-	int byte_count = sizeof(short) * pc->sensor_count * pc->channel_count * pc->sample_rate;
-	int data_count = sizeof(short) * pc->sensor_count * pc->channel_count * pc->sample_rate + pc->header_size;
-	int payload_count = 0;
+	reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	return_failure_if((reactor->epoll_fd < 0), PASS_FAILURE_GENERIC, "epoll_create1() failed: %s", strerror(errno));
 
-	unsigned char *data = (unsigned char *) (pc->input);
+	reactor->streams = calloc(total, sizeof(pass_reactor_stream));
+	return_failure_if((reactor->streams == NULL), PASS_FAILURE_NOMEM, "calloc() failed: %s", strerror(errno));
 
-	scratch_bytes *scratch = &(pc->scratch);
-	
-	if (unlikely(scratch->count + data_count > scratch->total)) {
-		/* too much data, emptying buffer */
-		if (unlikely(scratch->buffer)) {
-			memset(scratch->buffer, 0, scratch->count);
-			scratch->count = 0;
-		}
+	reactor->count = 0;
+	reactor->active = 0;
+	reactor->total = total;
 
-		return PASS_FAILURE_GAP_DETECTED;
+	return PASS_SUCCESS;
+}
+
+/*
+ * Waits up to timeout milliseconds for any stream to become readable, reads
+ * what is ready and fires the stream's callback once per complete frame. The
+ * frame views are valid for the duration of the callback. A reactor is driven
+ * from one thread, run one reactor per thread to spread streams over cores.
+ */
+pass_response pass_reactor_run(pass_reactor *reactor, const int timeout) {
+	struct epoll_event events[64];
+
+	if (reactor->active == 0)
+		return PASS_FAILURE_NO_CONN;
+
+	int ready = epoll_wait(reactor->epoll_fd, events, 64, timeout);
+	if (ready < 0) {
+		if (errno == EINTR)
+			return PASS_SUCCESS;
+		return_failure_if(true, PASS_FAILURE_GENERIC, "epoll_wait() failed: %s", strerror(errno));
 	}
 
-	/* copy input data into scratch buffer */
-	memcpy(&(scratch->buffer[scratch->count]), data, data_count);
-	scratch->count += data_count;
+	for (int i = 0; i < ready; i++) {
+		pass_reactor_stream *stream = events[i].data.ptr;
+		pass_context *pc = stream->pc;
 
-	while (unlikely(scratch->buffer)) {
-		if (scratch->count < PASS_DATA_HEADER_SIZE) {
-			/* insufficent data to search for a header */
-			if (payload_count != byte_count) {
-				return PASS_FAILURE_GAP_DETECTED;
-			}
-			else {
-				break;
-			}
+		int received = ring_fill(pc);
+		if (received <= 0) {
+			if ((received < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+				continue;
+
+			info(stdout, "stream closed");
+			epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, pc->sd, NULL);
+			pass_close(pc);
+			reactor->active--;
+			continue;
 		}
 
-		/* search for first header */
-		header_first_start = header_search(scratch->buffer, 0, scratch->count);
-		if (unlikely(header_first_start == scratch->count)) {
-			/* first header not found, removing old data */
-			memset(scratch->buffer, 0, scratch->count);
-			scratch->count = 0;
+		pass_response pr;
+		while ((pr = frame_next(pc)) != PASS_FAILURE_NO_DATA) {
+			if ((pr == PASS_SUCCESS) && (pc->header_size != 0)) {
+				sequence_id_update(pc);
+				if (frame_corrupt(pc))
+					pr = PASS_FAILURE_CHECKSUM;
+			}
 
-			return PASS_FAILURE_GAP_DETECTED;
+			stream->callback(pc, pr, stream->user_data);
 		}
+	}
 
-		/* search for second header */
-		header_first_end = header_first_start + PASS_DATA_HEADER_SIZE;
-		header_second_start = header_search(scratch->buffer, header_first_end, scratch->count);
+	return PASS_SUCCESS;
+}
 
-		int payload_size_received = header_second_start - header_first_end;
-		if (likely(payload_size_received == byte_count)) {
-			memcpy(pc->header, &(scratch->buffer[header_first_start]), PASS_DATA_HEADER_SIZE);
+pass_response pass_reactor_term(pass_reactor *reactor) {
+	if (reactor->epoll_fd >= 0)
+		close(reactor->epoll_fd);
+	reactor->epoll_fd = -1;
 
-			unsigned char *b = (unsigned char *)(pc->payload);
-			memcpy(b, &(scratch->buffer[header_first_end]), byte_count);
-			payload_count = byte_count;
+	if (reactor->streams != NULL) {
+		free(reactor->streams);
+		reactor->streams = NULL;
+	}
 
-			scratch->count = scratch->count - header_second_start;
-			memcpy(scratch->buffer, &(scratch->buffer[header_second_start]), scratch->count);
-			memset(&(scratch->buffer[scratch->count]), 0, scratch->total - scratch->count);
-		} else if (unlikely(payload_size_received > byte_count)) {
-			memset(scratch->buffer, 0, scratch->count);
-			scratch->count = 0;
+	reactor->count = 0;
+	reactor->active = 0;
+	reactor->total = 0;
 
-			return PASS_FAILURE_GAP_DETECTED;
-		} else {
-			if (unlikely(header_second_start < scratch->count)) {
-				/* there are two headers */
-				memset(scratch->buffer, 0, scratch->count);
-				scratch->count = 0;
+	return PASS_SUCCESS;
+}
 
-				return PASS_FAILURE_GAP_DETECTED;
-			} else {
-				scratch->count = scratch->count - header_first_start;
+/*
+ * In sync, a read scatters the header of the next frame into sync_header and
+ * its payload into sync_payload. The header has to be where the last frame
+ * ended, and a v2 header has to match the context, nothing waits for the frame
+ * after it. Otherwise everything read is handed to the ring to resynchronise.
+ */
+static pass_response read_in_sync(pass_context *pc) {
+	int byte_count = payload_size(pc);
+
+	struct iovec iov[2];
+	iov[0].iov_base = pc->sync_header;
+	iov[0].iov_len  = PASS_DATA_HEADER_SIZE;
+	iov[1].iov_base = pc->sync_payload;
+	iov[1].iov_len  = byte_count;
+
+	if (read_vector(pc->sd, iov, 2) < 0)
+		return PASS_FAILURE_GENERIC;
 
-				memcpy(scratch->buffer, &(scratch->buffer[header_first_start]), scratch->count);
-				memset(&(scratch->buffer[scratch->count]), 0, scratch->total - scratch->count);
-			}
-			break;
-		}
+	unsigned char *h = pc->sync_header;
+	if (likely(IS_PASS_DATA_HEADER(h) && (!header_is_v2(h) || header_v2_matches(pc, h)))) {
+		pc->header = h;
+		pc->payload = pc->sync_payload;
+
+		return PASS_SUCCESS;
 	}
 
-	unsigned char *h = pc->header;
-	uint32_t *tmp = (uint32_t *)(h + 28);
-	uint64_t s_id = bswap_32(*tmp);
+	/* lost sync, the ring is empty while in sync */
+	pass_ring *ring = &(pc->ring);
+	unsigned char *b = ring->buffer + ring->start;
 
-	pc->sequence_id = s_id;
+	memcpy(b, h, PASS_DATA_HEADER_SIZE);
+	memcpy(b + PASS_DATA_HEADER_SIZE, pc->sync_payload, byte_count);
+	ring->count = PASS_DATA_HEADER_SIZE + byte_count;
+
+	pc->in_sync = false;
 
 	return PASS_SUCCESS;
 }
 
-pass_response pass_octave_bands(pass_array *input, const int lower, const int upper) {
-	// TODO: check bounds
-
-	int index_lower, index_upper;
-
-	index_lower = (lower <= octave_band_smallest) ? 0 : lower - octave_band_smallest;
-	index_upper = (upper >= octave_band_largest) ? octave_band_largest - octave_band_smallest : upper - octave_band_smallest;
+pass_response pass_read(pass_context *pc) {
+	pass_response pr;
 
-	int i = 0;
-	double sum;
-	for (int j = index_lower; j < index_upper; j++) {
-		sum = octave_bands[j].lower_weight * input->values[ octave_bands[j].lower ];
-		for (int k = (octave_bands[j].lower + 1); k < octave_bands[j].upper; k++) {
-			sum += input->values[k];
-		}
-		sum += octave_bands[j].upper_weight * input->values[ octave_bands[j].upper ];
+	pc->placed = false;
 
-		input->values[i] = sum;
-		i++;
+	if (pc->datagram != NULL) {
+		pr = datagram_read(pc);
+		pc->placed = (pr == PASS_SUCCESS);
+		return pr;
 	}
-	input->count = i;
 
-	for (int j = i; j < input->total; j++) {
-		input->values[j] = 0.0;
+	if (pc->shm != NULL) {
+		pr = shm_read(pc);
+		pc->placed = (pr == PASS_SUCCESS);
+		return pr;
 	}
 
-	return PASS_SUCCESS;
+	if (pc->uring != NULL) {
+		pr = uring_read(pc);
+		pc->placed = (pr == PASS_SUCCESS) && (pc->header_size == 0);
+		return pr;
+	}
 
-}
+	if (pc->in_sync) {
+		pr = read_in_sync(pc);
+		pc->placed = (pr == PASS_SUCCESS) && pc->in_sync;
+		return pr;
+	}
 
-pass_response pass_read(pass_context *pc) {
 	int received;
-	int remaining = sizeof(short) * pc->sensor_count * pc->channel_count * pc->sample_rate + pc->header_size;
+	int remaining = payload_size(pc) + pc->header_size;
+
+	pass_ring *ring = &(pc->ring);
+	if (unlikely(ring->count + remaining > ring->total)) {
+		/* too much data, emptying buffer */
+		ring_discard(ring);
+	}
 
-	unsigned char *buf = (unsigned char *)(pc->input);
+	unsigned char *buf = ring->buffer + ring->start;
+	if ((pc->header_size != 0) &&
+	    (ring->count >= 16) && (ring->count < remaining) &&
+	    IS_PASS_DATA_HEADER(buf)) {
+		/* partial frame, read the rest of it to get back in sync */
+		remaining = remaining - ring->count;
+	}
+	buf += ring->count;
 
 	int count = 0;
 	int size = remaining;
@@ -585,10 +3809,14 @@ pass_response pass_read(pass_context *pc) {
 
 		count += received;
 		remaining -= received;
+		ring->count += received;
 	}
 
-	if (pc->header_size == 0)
-		memcpy(pc->payload, pc->input, count);
+	if (pc->header_size == 0) {
+		pc->payload = (short *)(buf);
+		ring_consume(ring, count);
+		pc->placed = true;
+	}
 
 	return PASS_SUCCESS;
 
@@ -606,7 +3834,7 @@ pass_response pass_wav_init(
 	desc->scale = scale;
 	desc->filename_length = 0;
 	desc->duration = duration;
-	desc->seconds_written = 0;
+	desc->samples_written = 0;
 
 	length = strlen(directory) + 1 + strlen(prefix) + DATESIZE + 4 + 1;
 	desc->filename = malloc(sizeof(char) * length);
@@ -641,7 +3869,7 @@ pass_response pass_wav_write(pass_context *pc, pass_wav_description *desc, const
 	char buffer[DATESIZE];
 	char header[44];
 
-	if (desc->seconds_written == 0) {
+	if (desc->samples_written == 0) {
 		memset(desc->filename, '\0', desc->filename_length);
 
 		time(&timer);
@@ -655,7 +3883,7 @@ pass_response pass_wav_write(pass_context *pc, pass_wav_description *desc, const
 	if (fp == NULL)
 		return PASS_FAILURE_GENERIC;
 
-	if (desc->seconds_written == 0) {
+	if (desc->samples_written == 0) {
 		int length = sizeof(struct wav_header)
 			+ sizeof(struct format_header)
 			+ sizeof(struct data_header)
@@ -684,18 +3912,20 @@ pass_response pass_wav_write(pass_context *pc, pass_wav_description *desc, const
 		fwrite(header, 44, 1, fp);
 	}
 
-	int samples_total = pc->sensor_count * pc->channel_count * pc->sample_rate;
+	int samples_total = pc->sensor_count * pc->channel_count * pc->frame_size;
 	for (int k = 0; k < samples_total; k += (pc->sensor_count * pc->channel_count)) {
 		int l = k + (sensor * pc->channel_count) + channel;
 		short s = pc->payload[l];
+		if (pc->flags & PASS_FLAG_ENDIAN_SWAP)
+			s = (short)bswap_16((uint16_t)s);
 		fwrite(&s, 2, 1, fp);
 	}
 
 	fclose(fp);
 
-	desc->seconds_written++;
-	if (desc->seconds_written == desc->duration) {
-		desc->seconds_written = 0;
+	desc->samples_written += pc->frame_size;
+	if (desc->samples_written >= desc->duration * pc->sample_rate) {
+		desc->samples_written = 0;
 	}
 
 	return PASS_SUCCESS;
@@ -708,8 +3938,117 @@ pass_response pass_wav_term(pass_wav_description *desc)
 	free(desc->directory);
 
 	desc->filename_length = 0;
-	desc->seconds_written = 0;
+	desc->samples_written = 0;
 	desc->duration = 0;
 
 	return PASS_SUCCESS;
 }
+
+pass_response pass_welch_execute(pass_welch *welch, pass_array *array, pass_fftw_plan *plan) {
+	return_failure_if((plan->flags & PASS_PLAN_SINGLE) || (array->values == NULL), PASS_FAILURE_GENERIC, "welch averaging is double precision");
+	return_failure_if((plan->frame_size != welch->segment) || (plan->transforms != 1), PASS_FAILURE_GENERIC, "plan does not match the segment");
+	return_failure_if((plan->windowed != NULL), PASS_FAILURE_GENERIC, "pruned plan, welch needs every bin");
+	return_failure_if((plan->output_rate > array->total), PASS_FAILURE_NOMEM, "insufficent memory");
+
+	int bins = plan->output_rate;
+	bool estimated = false;
+
+	for (int i = 0; i < array->count; ) {
+		if (welch->skip > 0) {
+			int n = (array->count - i < welch->skip) ? array->count - i : welch->skip;
+			welch->skip -= n;
+			i += n;
+			continue;
+		}
+
+		int n = welch->segment - welch->filled;
+		if (n > array->count - i)
+			n = array->count - i;
+
+		memcpy(welch->buffer + welch->filled, array->values + i, sizeof(double) * n);
+		welch->filled += n;
+		i += n;
+
+		if (welch->filled < welch->segment)
+			break;
+
+		for (int k = 0; k < welch->segment; k++)
+			plan->input[k] = welch->buffer[k] * plan->window[k];
+
+		fftw_execute(plan->plan_forward);
+
+		const fftw_complex *result = plan->result;
+		welch->sum[0] += result[0][0] * result[0][0];
+		for (int k = 1; k < bins; k++)
+			welch->sum[k] += 2.0 * (result[k][0] * result[k][0] + result[k][1] * result[k][1]);
+
+		welch->accumulated++;
+
+		/* keep the overlap for the next segment */
+		if (welch->hop < welch->segment) {
+			memmove(welch->buffer, welch->buffer + welch->hop, sizeof(double) * (welch->segment - welch->hop));
+			welch->filled = welch->segment - welch->hop;
+		} else {
+			welch->filled = 0;
+			welch->skip = welch->hop - welch->segment;
+		}
+
+		if (welch->accumulated == welch->averages) {
+			/* a later estimate in the same frame replaces this one, counted in superseded */
+			if (estimated)
+				welch->superseded++;
+
+			for (int k = 0; k < bins; k++) {
+				welch->estimate[k] = welch->sum[k] / welch->averages;
+				welch->sum[k] = 0.0;
+			}
+
+			welch->accumulated = 0;
+			estimated = true;
+		}
+	}
+
+	if (!estimated)
+		return PASS_FAILURE_NO_DATA;
+
+	memcpy(array->values, welch->estimate, sizeof(double) * bins);
+	array->count = bins;
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_welch_init(pass_welch *welch, const int segment, const int hop, const int averages) {
+	return_failure_if((segment < 2) || (hop < 1) || (averages < 1), PASS_FAILURE_GENERIC, "invalid segment %d, hop %d or averages %d", segment, hop, averages);
+
+	welch->segment = segment;
+	welch->hop = hop;
+	welch->averages = averages;
+
+	welch->filled = 0;
+	welch->skip = 0;
+	welch->accumulated = 0;
+	welch->superseded = 0;
+
+	welch->buffer = malloc(sizeof(double) * segment);
+	welch->sum = calloc((segment / 2) + 1, sizeof(double));
+	welch->estimate = calloc((segment / 2) + 1, sizeof(double));
+	if ((welch->buffer == NULL) || (welch->sum == NULL) || (welch->estimate == NULL)) {
+		pass_welch_term(welch);
+
+		return_failure_if(true, PASS_FAILURE_NOMEM, "allocation failed: %s", strerror(errno));
+	}
+
+	return PASS_SUCCESS;
+}
+
+pass_response pass_welch_term(pass_welch *welch) {
+	free(welch->buffer);
+	free(welch->sum);
+	free(welch->estimate);
+
+	welch->buffer = NULL;
+	welch->sum = NULL;
+	welch->estimate = NULL;
+
+	return PASS_SUCCESS;
+}
@@ -1,9 +1,11 @@
 // author john.d.sheehan@ie.ibm.com
 
 #include <byteswap.h>
+#include <limits.h>
 #include <math.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,20 +21,22 @@
 #include "macros.h"
 
 
-const char *cmd_options_available = "a:c:d:e:h:i:m:p:r:s:v:";
+const char *cmd_options_available = "a:c:d:e:f:h:i:m:p:r:s:v:w:";
 
 const char *cmd_options_help = "\
 -a: amplitude (default 0.01)\n\
 -c: channels (number of channels, default 1)\n\
 -d: chirp duration (default 5 seconds)\n\
 -e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
 -h: include header (0 - no header, 1 - header, default 1)\n\
 -i: max iterations (default 1200)\n\
 -m: max amplitude (1.0)\n\
 -p: port number (default 1234)\n\
 -r: sample rate (default 500000)\n\
 -s: sensors (number of sensors, default 1)\n\
--v: print data buffer (0 - no print, 1 - print, default 0)\n";
+-v: print data buffer (0 - no print, 1 - print, default 0)\n\
+-w: wire protocol version (1 - framed by the next header, 2 - header carries the payload length, default 2)\n";
 
 const char *sample_usage = "\
 sample args:\n\
@@ -43,10 +47,13 @@ struct cmd_options {
 	int    endian_swap;
 	int    header_use;
 	int    verbose;
+	int    wire_version;
 
 	int    sensors;
 	int    channels;
 	int    sample_rate;
+	int    frame_length;
+	int    frame_size;
 	int    max_iterations;
 
 	double amplitude;
@@ -59,10 +66,13 @@ struct cmd_options {
 
 struct __attribute__ ((__packed__)) header {
 	uint64_t magic;
-	uint64_t id;
+	uint64_t id;          // v2: frame sequence
 	uint64_t version;
 	uint64_t timestamp;
-	uint64_t reserved;
+	uint32_t length;      // v2: payload bytes, v1: reserved
+	uint16_t format;      // v2: 1 - int16
+	uint8_t  sensors;     // v2
+	uint8_t  channels;    // v2
 	int16_t  checksum;
 };
 
@@ -71,8 +81,10 @@ static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->channels	= 1;
 	cmd->chirp_duration  = 5.0;
 	cmd->endian_swap     = 0;
+	cmd->frame_length    = 1000;
 
 	cmd->header_use      = 1;
+	cmd->wire_version    = 2;
 	cmd->max_iterations  = 1200;
 	cmd->max_amplitude   = 1.0;
 
@@ -99,6 +111,7 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 			case 'c':  cmd->channels       = atoi(optarg);  break;
 			case 'd':  cmd->chirp_duration = atof(optarg);  break;
 			case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
 
 			case 'h':  cmd->header_use     = atoi(optarg);  break;
 			case 'i':  cmd->max_iterations = atoi(optarg);  break;
@@ -113,12 +126,17 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 			case 'r':  cmd->sample_rate    = atoi(optarg);  break;
 			case 's':  cmd->sensors	       = atoi(optarg);  break;
 			case 'v':  cmd->verbose	       = atoi(optarg);  break;
+			case 'w':  cmd->wire_version   = atoi(optarg);  break;
 			default:
 				flush(stdout, "%s\n", cmd_options_help);
 				flush(stdout, "%s\n", sample_usage);
 				exit(EXIT_SUCCESS);
 		}
 	}
+
+	long frame_samples = ((long)(cmd->sample_rate) * cmd->frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd->frame_length, cmd->sample_rate, frame_samples);
+	cmd->frame_size = (int)(frame_samples);
 }
 
 static void cmd_options_print(struct cmd_options *cmd) {
@@ -126,6 +144,7 @@ static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[c] channels	: %d", cmd->channels);
 	flush(stdout, "[d] chirp duration  : %f", cmd->chirp_duration);
 	flush(stdout, "[e] endian swap     : %s", (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length    : %d ms", cmd->frame_length);
 
 	flush(stdout, "[h] include header  : %s", (cmd->header_use == 1 ? "yes" : "no"));
 	flush(stdout, "[i] max iteration   : %d", cmd->max_iterations);
@@ -135,6 +154,7 @@ static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[r] sample rate     : %d", cmd->sample_rate);
 	flush(stdout, "[s] sensors	 : %d", cmd->sensors);
 	flush(stdout, "[v] verbose	 : %d", cmd->verbose);
+	flush(stdout, "[w] wire version    : %d", cmd->wire_version);
 }
 
 int connection_accept(int socket_listen, bool address_info_print) {
@@ -223,7 +243,7 @@ static short *sample_malloc(int *buffer_size, struct cmd_options *cmd) {
 	if (cmd->header_use)
 		header_len = 42;
 
-	*buffer_size = header_len + cmd->sensors * cmd->channels * cmd->sample_rate * sizeof(*sample);
+	*buffer_size = header_len + cmd->sensors * cmd->channels * cmd->frame_size * sizeof(*sample);
 	sample = malloc(*buffer_size);
 
 	return sample;
@@ -245,6 +265,7 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 	int i, j, k, l;
 
 	struct header h;
+	static uint64_t sequence = 1;
 
 	int header_len = 0;
 	if (cmd->header_use) {
@@ -255,7 +276,7 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 		data = sample + (header_len / sizeof(short));
 
 		l = 0;
-		for (i = 0; i < cmd->sample_rate; i++) {
+		for (i = 0; i < cmd->frame_size; i++) {
 			double t = *time_elapsed;
 			double r = scale * sin(two_pi * (((constant * t * t) / 2.0) + (frequency_start * t)));
 
@@ -282,19 +303,31 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 
 		if (cmd->header_use) {
 			unsigned short total = 0;
-			for (i = 0; i < cmd->sensors * cmd->channels * cmd->sample_rate; i += 2) {
+			for (i = 0; i < cmd->sensors * cmd->channels * cmd->frame_size; i += 2) {
 				unsigned short *b = (unsigned short *)(data + i);
 				unsigned short  t = bswap_16(*b);
 				total += t;
 			}
 
 			h.magic      = 0xC0C0C0C0C0C0C0C0;
-			h.id	 = 1;
+			h.id         = 1;
 			h.version    = 1;
 			h.timestamp  = 1;
-			h.reserved   = 0;
+			h.length     = 0;
+			h.format     = 0;
+			h.sensors    = 0;
+			h.channels   = 0;
 			h.checksum   = total;
 
+			if (cmd->wire_version == 2) {
+				h.id         = sequence++;
+				h.version    = 2;
+				h.length     = sizeof(short) * cmd->sensors * cmd->channels * cmd->frame_size;
+				h.format     = 1;
+				h.sensors    = cmd->sensors;
+				h.channels   = cmd->channels;
+			}
+
 			memcpy(sample, &h, 42);
 		}
 	}
@@ -366,6 +399,9 @@ int main(int argc, char *argv[]) {
 	cmd_options_parse(&cmd, argc, argv);
 	cmd_options_print(&cmd);
 
+	exit_failure_if((cmd.wire_version == 2) && ((cmd.sensors > UINT8_MAX) || (cmd.channels > UINT8_MAX)),
+		"v2 headers hold at most %d sensors and %d channels, use -w 1", UINT8_MAX, UINT8_MAX);
+
 	sample = sample_malloc(&buffer_size, &cmd);
 	exit_failure_if(sample == NULL, "failed to allocate sample memory");
 
@@ -387,7 +423,9 @@ int main(int argc, char *argv[]) {
 	}
 
 	double time_elapsed = 0.0;
-	for (int l = 0; l < cmd.max_iterations && PROCEED; l++) {
+	double frames_per_second = 1000.0 / cmd.frame_length;
+	int total_loops = (int)(lround(cmd.max_iterations * frames_per_second));
+	for (int l = 0; l < total_loops && PROCEED; l++) {
 		sample_generate(sample, &time_elapsed, &cmd);
 
 		if (cmd.verbose)
@@ -397,8 +435,8 @@ int main(int argc, char *argv[]) {
 		reads = master;
 
 		struct timeval timeout;
-		timeout.tv_sec = 1;
-		timeout.tv_usec = 0;
+		timeout.tv_sec = cmd.frame_length / 1000;
+		timeout.tv_usec = (cmd.frame_length % 1000) * 1000;
 
 		rc = select(socket_max+1, &reads, 0, 0, &timeout);
 		exit_failure_if((rc < 0), "select() failed: %s", strerror(errno));
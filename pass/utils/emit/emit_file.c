@@ -1,9 +1,12 @@
 // author john.d.sheehan@ie.ibm.com
 
+#define _GNU_SOURCE
+
 #include <byteswap.h>
 #include <math.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,14 +18,22 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "macros.h"
 
-const char *cmd_options_available = "b:f:n:";
+const char *cmd_options_available = "b:f:g:k:n:";
 
 const char *cmd_options_help = "\
 -b: bytes (how many bytes in each send (default is 1000000)  \n\
 -f: file name                                                \n\
+-g: multicast group (send once to the group over udp)       \n\
+-k: shared memory name (publish once to shm://name)          \n\
 -n: port number to use (default is 1234)                     \n\
 -v: verbose (0 - no print, 1 - print, default 0)             \n\
                                                              \n\
@@ -40,6 +51,8 @@ struct cmd_options {
 	int bytes;
 	int verbose;
 
+	char group[256];
+	char shm_name[256];
 	char port_number[16];
 };
 
@@ -52,11 +65,44 @@ struct __attribute__ ((__packed__)) header {
 	int16_t  checksum;
 };
 
+// udp fragments, matching pass_fragment_header in libpass
+#define FRAGMENT_SIZE         1472
+#define FRAGMENT_HEADER_SIZE  12
+#define FRAGMENT_PAYLOAD      (FRAGMENT_SIZE - FRAGMENT_HEADER_SIZE)
+#define FRAGMENT_BATCH        64
+
+struct __attribute__ ((__packed__)) fragment_header {
+	uint32_t sequence;
+	uint32_t length;
+	uint16_t index;
+	uint16_t count;
+};
+
+// shared memory frames, matching pass_shm_header in libpass
+#define SHM_MAGIC  0x73736170
+#define SHM_ALIGN  64
+#define SHM_SLOTS  8
+
+struct shm_header {
+	uint32_t magic;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	uint32_t frame_bytes;
+	uint32_t futex;
+	uint32_t waiters;
+	uint32_t closed;
+	uint32_t reserved;
+	uint64_t published;
+};
+
 static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->filename = NULL;
 	cmd->bytes = 1000000;
 	cmd->verbose = 0;
 
+	memset(cmd->group, '\0', sizeof(cmd->group));
+	memset(cmd->shm_name, '\0', sizeof(cmd->shm_name));
+
 	memset(cmd->port_number, '\0', sizeof(cmd->port_number));
 	strcpy(cmd->port_number, "1234");
 }
@@ -74,6 +120,16 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 		switch (c) {
 		case 'b':  cmd->bytes     = atoi(optarg);  break;
 		case 'f':  cmd->filename  = optarg;        break;
+		case 'g':
+			if (strlen(optarg) < 255) {
+				strcpy(cmd->group, optarg);
+			}
+			break;
+		case 'k':
+			if (strlen(optarg) < 255) {
+				strcpy(cmd->shm_name, optarg);
+			}
+			break;
 		case 'n':
 			if (strlen(optarg) < 15) {
 				strcpy(cmd->port_number, optarg);
@@ -99,6 +155,8 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[b] bytes        : %d", cmd->bytes);
 	flush(stdout, "[f] filename     : %s", cmd->filename);
+	flush(stdout, "[g] group        : %s", (cmd->group[0] != '\0') ? cmd->group : "none");
+	flush(stdout, "[k] shm name     : %s", (cmd->shm_name[0] != '\0') ? cmd->shm_name : "none");
 	flush(stdout, "[n] port number  : %s", cmd->port_number);
 	flush(stdout, "[v] verbose      : %d (%s)", cmd->verbose, (cmd->verbose == 1 ? "yes" : "no"));
 }
@@ -173,6 +231,159 @@ int connection_create(char *port, int max_connections) {
 	return socket_listen;
 }
 
+int multicast_create(char *group, char *port, struct sockaddr_in *group_address) {
+	int rc;
+
+	info(stdout, "configuring group address: %s %s", group, port);
+
+	struct addrinfo hints;
+	memset(&hints, '\0', sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	struct addrinfo *address;
+	rc = getaddrinfo(group, port, &hints, &address);
+	return_failure_if((rc != 0), -1, "getaddrinfo() failed: %s", gai_strerror(rc));
+
+	memcpy(group_address, address->ai_addr, sizeof(struct sockaddr_in));
+	freeaddrinfo(address);
+
+	int socket_group = socket(AF_INET, SOCK_DGRAM, 0);
+	return_failure_if((socket_group < 0), -1, "socket() failed: %s", strerror(errno));
+
+	// keep the group on the local network, and let local consumers see it
+	unsigned char ttl = 1;
+	rc = setsockopt(socket_group, IPPROTO_IP, IP_MULTICAST_TTL, (void*)&ttl, sizeof(ttl));
+	return_failure_if((rc < 0), -1, "setsockopt() failed: %s", strerror(errno));
+
+	unsigned char loop = 1;
+	rc = setsockopt(socket_group, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&loop, sizeof(loop));
+	return_failure_if((rc < 0), -1, "setsockopt() failed: %s", strerror(errno));
+
+	return socket_group;
+}
+
+// sends a frame once, as fragments that fit the mtu
+int multicast_send(int socket_group, struct sockaddr_in *group_address, void *frame, int size, uint32_t sequence) {
+	struct fragment_header headers[FRAGMENT_BATCH];
+	struct iovec iov[FRAGMENT_BATCH][2];
+	struct mmsghdr messages[FRAGMENT_BATCH];
+
+	int count = (size + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD;
+
+	for (int first = 0; first < count; first += FRAGMENT_BATCH) {
+		int n = count - first;
+		if (n > FRAGMENT_BATCH)
+			n = FRAGMENT_BATCH;
+
+		for (int k = 0; k < n; k++) {
+			int index = first + k;
+			int offset = index * FRAGMENT_PAYLOAD;
+			int length = size - offset;
+			if (length > FRAGMENT_PAYLOAD)
+				length = FRAGMENT_PAYLOAD;
+
+			headers[k].sequence = htonl(sequence);
+			headers[k].length   = htonl(size);
+			headers[k].index    = htons(index);
+			headers[k].count    = htons(count);
+
+			iov[k][0].iov_base = &headers[k];
+			iov[k][0].iov_len  = FRAGMENT_HEADER_SIZE;
+			iov[k][1].iov_base = (unsigned char *)frame + offset;
+			iov[k][1].iov_len  = length;
+
+			memset(&messages[k], 0, sizeof(struct mmsghdr));
+			messages[k].msg_hdr.msg_name    = group_address;
+			messages[k].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			messages[k].msg_hdr.msg_iov     = iov[k];
+			messages[k].msg_hdr.msg_iovlen  = 2;
+		}
+
+		int sent = 0;
+		while (sent < n) {
+			int rc = sendmmsg(socket_group, messages + sent, n - sent, 0);
+			if (rc < 0) {
+				if (errno == EINTR)
+					continue;
+				return_failure_if(true, -1, "sendmmsg() failed: %s", strerror(errno));
+			}
+			sent += rc;
+		}
+	}
+
+	return 0;
+}
+
+struct shm_header *shm_create(char *name, int frame_bytes, size_t *size) {
+	char path[256];
+	snprintf(path, sizeof(path), "/%s", name);
+
+	info(stdout, "configuring shared memory: %s", path);
+
+	int slot_size = SHM_ALIGN + ((frame_bytes + SHM_ALIGN - 1) / SHM_ALIGN) * SHM_ALIGN;
+	*size = SHM_ALIGN + (size_t)SHM_SLOTS * slot_size;
+
+	// reused when it exists, consumers still attached see published go back to 0
+	int fd = shm_open(path, O_CREAT | O_RDWR, 0666);
+	return_failure_if((fd < 0), NULL, "shm_open() failed: %s", strerror(errno));
+
+	int rc = ftruncate(fd, *size);
+	if (rc != 0) {
+		close(fd);
+		return_failure_if(true, NULL, "ftruncate() failed: %s", strerror(errno));
+	}
+
+	struct shm_header *h = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return_failure_if((h == MAP_FAILED), NULL, "mmap() failed: %s", strerror(errno));
+
+	__atomic_store_n(&h->magic, 0, __ATOMIC_RELEASE);
+
+	h->slot_count  = SHM_SLOTS;
+	h->slot_size   = slot_size;
+	h->frame_bytes = frame_bytes;
+	h->closed      = 0;
+	for (int i = 0; i < SHM_SLOTS; i++) {
+		uint64_t *sequence = (uint64_t *)((unsigned char *)h + SHM_ALIGN + (size_t)i * slot_size);
+		*sequence = 0;
+	}
+	__atomic_store_n(&h->published, 0, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&h->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return h;
+}
+
+// copies a frame into the next slot, the slot sequence is odd while it is written
+void shm_publish(struct shm_header *h, void *frame, int frame_bytes) {
+	uint64_t n = h->published;
+
+	unsigned char *slot = (unsigned char *)h + SHM_ALIGN + (n % h->slot_count) * h->slot_size;
+	uint64_t *sequence = (uint64_t *)slot;
+
+	__atomic_store_n(sequence, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(slot + SHM_ALIGN, frame, frame_bytes);
+
+	__atomic_store_n(sequence, 2 * (n + 1), __ATOMIC_RELEASE);
+	__atomic_store_n(&h->published, n + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&h->futex, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&h->waiters, __ATOMIC_SEQ_CST) != 0)
+		syscall(SYS_futex, &h->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void shm_close(struct shm_header *h, size_t size) {
+	__atomic_store_n(&h->closed, 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&h->futex, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &h->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	munmap(h, size);
+}
+
 volatile sig_atomic_t PROCEED = 1;
 void term(int signum) {
 	info(stdout, "signal: %d", signum);
@@ -207,14 +418,39 @@ int main(int argc, char *argv[]) {
 	exit_failure_if((data_buffer == NULL), "failed to allocate memory");
 	memset(data_buffer, 0, data_size);
 
-	int socket_listen = connection_create(cmd.port_number, 16);
-	exit_failure_if((socket_listen < 0), "connection_create() failed: %s", strerror(errno));
-
-	int socket_max = socket_listen;
+	int socket_listen = -1;
+	int socket_max = -1;
 
 	fd_set master;
 	FD_ZERO(&master);
-	FD_SET(socket_listen, &master);
+
+	// with a group every send goes out once, however many consumers joined
+	int socket_group = -1;
+	struct sockaddr_in group_address;
+	uint32_t sequence = 0;
+
+	if (cmd.group[0] != '\0') {
+		int fragments = (data_size + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD;
+		exit_failure_if((fragments > UINT16_MAX), "frames of %d bytes take %d fragments, udp carries at most %d", data_size, fragments, UINT16_MAX);
+
+		socket_group = multicast_create(cmd.group, cmd.port_number, &group_address);
+		exit_failure_if((socket_group < 0), "multicast_create() failed");
+	} else {
+		socket_listen = connection_create(cmd.port_number, 16);
+		exit_failure_if((socket_listen < 0), "connection_create() failed: %s", strerror(errno));
+
+		socket_max = socket_listen;
+		FD_SET(socket_listen, &master);
+	}
+
+	// consumers on this host can share one copy of every frame
+	struct shm_header *shm = NULL;
+	size_t shm_size = 0;
+
+	if (cmd.shm_name[0] != '\0') {
+		shm = shm_create(cmd.shm_name, data_size, &shm_size);
+		exit_failure_if((shm == NULL), "shm_create() failed");
+	}
 
 	while (PROCEED) {
 		fd_set reads, writes;
@@ -281,13 +517,25 @@ int main(int argc, char *argv[]) {
 						close(i);
 						break;
 					}
-					offset = offset + (sent / sizeof(int));
+					offset = offset + sent;
 					remaining = remaining - sent;
 				} while(remaining != 0);
 			}
-		}		
+		}
+
+		if (socket_group >= 0) {
+			rc = multicast_send(socket_group, &group_address, data_buffer, data_size, sequence);
+			exit_failure_if((rc < 0), "multicast_send() failed");
+			sequence++;
+		}
+
+		if (shm != NULL)
+			shm_publish(shm, data_buffer, data_size);
 	}
 
+	if (shm != NULL)
+		shm_close(shm, shm_size);
+
 	fclose(data_fp);
 	free(data_buffer);
 
@@ -297,7 +545,10 @@ int main(int argc, char *argv[]) {
 			close(i);
 		}
 	}
-	close(socket_listen);
+	if (socket_listen >= 0)
+		close(socket_listen);
+	if (socket_group >= 0)
+		close(socket_group);
 
 	return EXIT_SUCCESS;
 }
@@ -1,9 +1,12 @@
 // author john.d.sheehan@ie.ibm.com
 
+#define _GNU_SOURCE
+
 #include <byteswap.h>
 #include <math.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,18 +18,27 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "macros.h"
 
 
-const char *cmd_options_available = "a:c:e:h:i:l:m:n:p:r:s:u:v:";
+const char *cmd_options_available = "a:c:e:f:g:h:i:k:l:m:n:p:r:s:u:v:w:";
 
 const char *cmd_options_help = "\
 -a: amplitude (default 0.01)\n\
 -c: channels (number of channels, default 1)\n\
 -e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
+-g: multicast group (send each frame once to the group over udp, default none - tcp)\n\
 -h: include header (0 - no header, 1 - header, default 1)\n\
 -i: max iterations (default 1200)\n\
+-k: shared memory name (publish each frame once to shm://name for consumers on this host, default none)\n\
 -l: lower frequency (default 128)\n\
 -m: max amplitude (1.0)\n\
 -n: port number (default 1234)\n\
@@ -34,7 +46,8 @@ const char *cmd_options_help = "\
 -r: sample rate (default 500000)\n\
 -s: sensors (number of sensors, default 1)\n\
 -u: upper frequency (default 8192)\n\
--v: print data buffer (0 - no print, 1 - print, default 0)\n";
+-v: print data buffer (0 - no print, 1 - print, default 0)\n\
+-w: wire protocol version (1 - framed by the next header, 2 - header carries the payload length, default 2)\n";
 
 const char *sample_usage = "\
 sample args:\n\
@@ -45,10 +58,13 @@ struct cmd_options {
 	int    endian_swap;
 	int    header_use;
 	int    verbose;
+	int    wire_version;
 
 	int    sensors;
 	int    channels;
 	int    sample_rate;
+	int    frame_length;
+	int    frame_size;
 	int    max_iterations;
 	int    period;
 
@@ -57,25 +73,65 @@ struct cmd_options {
 	double frequency_l;
 	double frequency_u;
 
+	char group[256];
+	char shm_name[256];
 	char port_number[16];
 };
 
 
 struct __attribute__ ((__packed__)) header {
 	uint64_t magic;
-	uint64_t id;
+	uint64_t id;          // v2: frame sequence
 	uint64_t version;
 	uint64_t timestamp;
-	uint64_t reserved;
+	uint32_t length;      // v2: payload bytes, v1: reserved
+	uint16_t format;      // v2: 1 - int16
+	uint8_t  sensors;     // v2
+	uint8_t  channels;    // v2
 	int16_t  checksum;
 };
 
+// udp fragments, matching pass_fragment_header in libpass
+#define FRAGMENT_SIZE         1472
+#define FRAGMENT_HEADER_SIZE  12
+#define FRAGMENT_PAYLOAD      (FRAGMENT_SIZE - FRAGMENT_HEADER_SIZE)
+#define FRAGMENT_BATCH        64
+
+struct __attribute__ ((__packed__)) fragment_header {
+	uint32_t sequence;
+	uint32_t length;
+	uint16_t index;
+	uint16_t count;
+};
+
+// shared memory frames, matching pass_shm_header in libpass
+#define SHM_MAGIC  0x73736170
+#define SHM_ALIGN  64
+#define SHM_SLOTS  8
+
+struct shm_header {
+	uint32_t magic;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	uint32_t frame_bytes;
+	uint32_t futex;
+	uint32_t waiters;
+	uint32_t closed;
+	uint32_t reserved;
+	uint64_t published;
+};
+
 static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->amplitude       = 0.01;
 	cmd->channels        = 1;
 	cmd->endian_swap     = 0;
+	cmd->frame_length    = 1000;
+
+	memset(cmd->group, '\0', sizeof(cmd->group));
+	memset(cmd->shm_name, '\0', sizeof(cmd->shm_name));
 
 	cmd->header_use      = 1;
+	cmd->wire_version    = 2;
 	cmd->max_iterations  = 1200;
 	cmd->frequency_l     = 256.0;
 	cmd->max_amplitude   = 1.0;
@@ -104,10 +160,25 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 		case 'a':  cmd->amplitude      = atof(optarg);  break;
 		case 'c':  cmd->channels       = atoi(optarg);  break;
 		case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+		case 'f':  cmd->frame_length   = atoi(optarg);  break;
+
+		case 'g':
+			if (strlen(optarg) < 255) {
+				strcpy(cmd->group, optarg);
+			}
+			break;
+
 		case 'h':  cmd->header_use     = atoi(optarg);  break;
 
 		case 'l':  cmd->frequency_l    = atof(optarg);  break;
 		case 'i':  cmd->max_iterations = atoi(optarg);  break;
+
+		case 'k':
+			if (strlen(optarg) < 255) {
+				strcpy(cmd->shm_name, optarg);
+			}
+			break;
+
 		case 'm':  cmd->max_amplitude  = atof(optarg);  break;
 
 		case 'n':
@@ -121,6 +192,7 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 		case 'p':  cmd->period	       = atoi(optarg);  break;
 		case 'u':  cmd->frequency_u    = atof(optarg);  break;
 		case 'v':  cmd->verbose        = atoi(optarg);  break;
+		case 'w':  cmd->wire_version   = atoi(optarg);  break;
 
 		default:
 			flush(stdout, "%s\n", cmd_options_help);
@@ -128,14 +200,21 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 			exit(EXIT_SUCCESS);
 		}
 	}
+
+	long frame_samples = ((long)(cmd->sample_rate) * cmd->frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd->frame_length, cmd->sample_rate, frame_samples);
+	cmd->frame_size = (int)(frame_samples);
 }
 
 static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[a] amplitude       : %.02f", cmd->amplitude);
 	flush(stdout, "[c] channels        : %d", cmd->channels);
 	flush(stdout, "[e] endian swap     : %d (%s)", cmd->endian_swap, (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length    : %d ms", cmd->frame_length);
+	flush(stdout, "[g] multicast group : %s", (cmd->group[0] != '\0') ? cmd->group : "none");
 	flush(stdout, "[h] include header  : %d (%s)", cmd->header_use, (cmd->header_use == 1 ? "yes" : "no"));
 	flush(stdout, "[i] max iteration   : %d", cmd->max_iterations);
+	flush(stdout, "[k] shared memory   : %s", (cmd->shm_name[0] != '\0') ? cmd->shm_name : "none");
 	flush(stdout, "[l] frequency lower : %.02f", cmd->frequency_l);
 	flush(stdout, "[m] max amplitude   : %.02f", cmd->max_amplitude);
 	flush(stdout, "[n] port number     : %s", cmd->port_number);
@@ -144,6 +223,7 @@ static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[s] sensors         : %d", cmd->sensors);
 	flush(stdout, "[u] frequency_upper : %.02f", cmd->frequency_u);
 	flush(stdout, "[v] verbose         : %d (%s)", cmd->verbose, (cmd->verbose == 1 ? "yes" : "no"));
+	flush(stdout, "[w] wire version    : %d", cmd->wire_version);
 }
 
 int connection_accept(int socket_listen, bool address_info_print) {
@@ -216,6 +296,159 @@ int connection_create(char *port, int max_connections) {
 	return socket_listen;
 }
 
+int multicast_create(char *group, char *port, struct sockaddr_in *group_address) {
+	int rc;
+
+	info(stdout, "configuring group address: %s %s", group, port);
+
+	struct addrinfo hints;
+	memset(&hints, '\0', sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	struct addrinfo *address;
+	rc = getaddrinfo(group, port, &hints, &address);
+	return_failure_if((rc != 0), -1, "getaddrinfo() failed: %s", gai_strerror(rc));
+
+	memcpy(group_address, address->ai_addr, sizeof(struct sockaddr_in));
+	freeaddrinfo(address);
+
+	int socket_group = socket(AF_INET, SOCK_DGRAM, 0);
+	return_failure_if((socket_group < 0), -1, "socket() failed: %s", strerror(errno));
+
+	// keep the group on the local network, and let local consumers see it
+	unsigned char ttl = 1;
+	rc = setsockopt(socket_group, IPPROTO_IP, IP_MULTICAST_TTL, (void*)&ttl, sizeof(ttl));
+	return_failure_if((rc < 0), -1, "setsockopt() failed: %s", strerror(errno));
+
+	unsigned char loop = 1;
+	rc = setsockopt(socket_group, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&loop, sizeof(loop));
+	return_failure_if((rc < 0), -1, "setsockopt() failed: %s", strerror(errno));
+
+	return socket_group;
+}
+
+// sends a frame once, as fragments that fit the mtu
+int multicast_send(int socket_group, struct sockaddr_in *group_address, void *frame, int size, uint32_t sequence) {
+	struct fragment_header headers[FRAGMENT_BATCH];
+	struct iovec iov[FRAGMENT_BATCH][2];
+	struct mmsghdr messages[FRAGMENT_BATCH];
+
+	int count = (size + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD;
+
+	for (int first = 0; first < count; first += FRAGMENT_BATCH) {
+		int n = count - first;
+		if (n > FRAGMENT_BATCH)
+			n = FRAGMENT_BATCH;
+
+		for (int k = 0; k < n; k++) {
+			int index = first + k;
+			int offset = index * FRAGMENT_PAYLOAD;
+			int length = size - offset;
+			if (length > FRAGMENT_PAYLOAD)
+				length = FRAGMENT_PAYLOAD;
+
+			headers[k].sequence = htonl(sequence);
+			headers[k].length   = htonl(size);
+			headers[k].index    = htons(index);
+			headers[k].count    = htons(count);
+
+			iov[k][0].iov_base = &headers[k];
+			iov[k][0].iov_len  = FRAGMENT_HEADER_SIZE;
+			iov[k][1].iov_base = (unsigned char *)frame + offset;
+			iov[k][1].iov_len  = length;
+
+			memset(&messages[k], 0, sizeof(struct mmsghdr));
+			messages[k].msg_hdr.msg_name    = group_address;
+			messages[k].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			messages[k].msg_hdr.msg_iov     = iov[k];
+			messages[k].msg_hdr.msg_iovlen  = 2;
+		}
+
+		int sent = 0;
+		while (sent < n) {
+			int rc = sendmmsg(socket_group, messages + sent, n - sent, 0);
+			if (rc < 0) {
+				if (errno == EINTR)
+					continue;
+				return_failure_if(true, -1, "sendmmsg() failed: %s", strerror(errno));
+			}
+			sent += rc;
+		}
+	}
+
+	return 0;
+}
+
+struct shm_header *shm_create(char *name, int frame_bytes, size_t *size) {
+	char path[256];
+	snprintf(path, sizeof(path), "/%s", name);
+
+	info(stdout, "configuring shared memory: %s", path);
+
+	int slot_size = SHM_ALIGN + ((frame_bytes + SHM_ALIGN - 1) / SHM_ALIGN) * SHM_ALIGN;
+	*size = SHM_ALIGN + (size_t)SHM_SLOTS * slot_size;
+
+	// reused when it exists, consumers still attached see published go back to 0
+	int fd = shm_open(path, O_CREAT | O_RDWR, 0666);
+	return_failure_if((fd < 0), NULL, "shm_open() failed: %s", strerror(errno));
+
+	int rc = ftruncate(fd, *size);
+	if (rc != 0) {
+		close(fd);
+		return_failure_if(true, NULL, "ftruncate() failed: %s", strerror(errno));
+	}
+
+	struct shm_header *h = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return_failure_if((h == MAP_FAILED), NULL, "mmap() failed: %s", strerror(errno));
+
+	__atomic_store_n(&h->magic, 0, __ATOMIC_RELEASE);
+
+	h->slot_count  = SHM_SLOTS;
+	h->slot_size   = slot_size;
+	h->frame_bytes = frame_bytes;
+	h->closed      = 0;
+	for (int i = 0; i < SHM_SLOTS; i++) {
+		uint64_t *sequence = (uint64_t *)((unsigned char *)h + SHM_ALIGN + (size_t)i * slot_size);
+		*sequence = 0;
+	}
+	__atomic_store_n(&h->published, 0, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&h->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return h;
+}
+
+// copies a frame into the next slot, the slot sequence is odd while it is written
+void shm_publish(struct shm_header *h, void *frame, int frame_bytes) {
+	uint64_t n = h->published;
+
+	unsigned char *slot = (unsigned char *)h + SHM_ALIGN + (n % h->slot_count) * h->slot_size;
+	uint64_t *sequence = (uint64_t *)slot;
+
+	__atomic_store_n(sequence, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(slot + SHM_ALIGN, frame, frame_bytes);
+
+	__atomic_store_n(sequence, 2 * (n + 1), __ATOMIC_RELEASE);
+	__atomic_store_n(&h->published, n + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&h->futex, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&h->waiters, __ATOMIC_SEQ_CST) != 0)
+		syscall(SYS_futex, &h->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void shm_close(struct shm_header *h, size_t size) {
+	__atomic_store_n(&h->closed, 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&h->futex, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &h->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	munmap(h, size);
+}
+
 volatile sig_atomic_t PROCEED = 1;
 void term(int signum) {
 	info(stdout, "signal: %d", signum);
@@ -232,7 +465,7 @@ static short *sample_malloc(int *buffer_size, struct cmd_options *cmd) {
 	if (cmd->header_use)
 		header_len = 42;
 
-	*buffer_size = header_len + cmd->sensors * cmd->channels * cmd->sample_rate * sizeof(*sample);
+	*buffer_size = header_len + cmd->sensors * cmd->channels * cmd->frame_size * sizeof(*sample);
 	sample = malloc(*buffer_size);
 
 	return sample;
@@ -246,6 +479,7 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 	double delta, two_pi, scale;
 
 	struct header h;
+	static uint64_t sequence = 1;
 
 	int header_len = 0;
 	if (cmd->header_use) {
@@ -260,7 +494,7 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 		scale = 32767.0 / cmd->max_amplitude;
 
 		l = 0;
-		for (i = 0; i < cmd->sample_rate; i++) {
+		for (i = 0; i < cmd->frame_size; i++) {
 			double t = *time_elapsed;
 			double r = scale * cmd->amplitude * sin(frequency * two_pi * t);
 
@@ -284,7 +518,7 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 
 		if (cmd->header_use) {
 			unsigned short total = 0;
-			for (i = 0; i < cmd->sensors * cmd->channels * cmd->sample_rate; i += 2) {
+			for (i = 0; i < cmd->sensors * cmd->channels * cmd->frame_size; i += 2) {
 				unsigned short b = *((unsigned short *)(data + i));
 				unsigned short t = bswap_16(b);
 				total += t;
@@ -294,9 +528,21 @@ static void sample_generate(short *sample, double *time_elapsed, struct cmd_opti
 			h.id         = 1;
 			h.version    = 1;
 			h.timestamp  = 1;
-			h.reserved   = 0;
+			h.length     = 0;
+			h.format     = 0;
+			h.sensors    = 0;
+			h.channels   = 0;
 			h.checksum   = total;
 
+			if (cmd->wire_version == 2) {
+				h.id         = sequence++;
+				h.version    = 2;
+				h.length     = sizeof(short) * cmd->sensors * cmd->channels * cmd->frame_size;
+				h.format     = 1;
+				h.sensors    = cmd->sensors;
+				h.channels   = cmd->channels;
+			}
+
 			memcpy(sample, &h, 42);
 		}
 	}
@@ -367,6 +613,9 @@ int main(int argc, char *argv[]) {
 	cmd_options_parse(&cmd, argc, argv);
 	cmd_options_print(&cmd);
 
+	exit_failure_if((cmd.wire_version == 2) && ((cmd.sensors > UINT8_MAX) || (cmd.channels > UINT8_MAX)),
+		"v2 headers hold at most %d sensors and %d channels, use -w 1", UINT8_MAX, UINT8_MAX);
+
 
 	short *sample = NULL;
 	int buffer_size;
@@ -376,14 +625,39 @@ int main(int argc, char *argv[]) {
 	info(stdout, "allocated: %d", buffer_size);
 
 
-	int socket_listen = connection_create(cmd.port_number, 16);
-	exit_failure_if((socket_listen < 0), "connection_create() failed: %s", strerror(errno));
-
-	int socket_max = socket_listen;
+	int socket_listen = -1;
+	int socket_max = -1;
 
 	fd_set master;
 	FD_ZERO(&master);
-	FD_SET(socket_listen, &master);
+
+	// with a group every frame is sent once, however many consumers joined
+	int socket_group = -1;
+	struct sockaddr_in group_address;
+	uint32_t sequence = 0;
+
+	if (cmd.group[0] != '\0') {
+		int fragments = (buffer_size + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD;
+		exit_failure_if((fragments > UINT16_MAX), "frames of %d bytes take %d fragments, udp carries at most %d", buffer_size, fragments, UINT16_MAX);
+
+		socket_group = multicast_create(cmd.group, cmd.port_number, &group_address);
+		exit_failure_if((socket_group < 0), "multicast_create() failed");
+	} else {
+		socket_listen = connection_create(cmd.port_number, 16);
+		exit_failure_if((socket_listen < 0), "connection_create() failed: %s", strerror(errno));
+
+		socket_max = socket_listen;
+		FD_SET(socket_listen, &master);
+	}
+
+	// consumers on this host can share one copy of every frame
+	struct shm_header *shm = NULL;
+	size_t shm_size = 0;
+
+	if (cmd.shm_name[0] != '\0') {
+		shm = shm_create(cmd.shm_name, buffer_size, &shm_size);
+		exit_failure_if((shm == NULL), "shm_create() failed");
+	}
 
 
 	FILE *fp = NULL;
@@ -397,10 +671,14 @@ int main(int argc, char *argv[]) {
 
 	double frequency = cmd.frequency_l;
 	double time_elapsed = 0.0;
-	int total_loops = cmd.max_iterations * cmd.period;
+	double frames_per_second = 1000.0 / cmd.frame_length;
+	int frames_per_period = (int)(lround(cmd.period * frames_per_second));
+	if (frames_per_period < 1)
+		frames_per_period = 1;
+	int total_loops = (int)(lround(cmd.max_iterations * cmd.period * frames_per_second));
 	for (int l = 0; l < total_loops && PROCEED; l++) {
 		// select sample
-		if ((l % cmd.period) == 0) {
+		if ((l % frames_per_period) == 0) {
 			frequency = (frequency == cmd.frequency_l) ? cmd.frequency_u : cmd.frequency_l;
 			info(stdout, "switching frequency %.2lf, % 8d", frequency, l);
 		}
@@ -414,8 +692,8 @@ int main(int argc, char *argv[]) {
 		reads = master;
 
 		struct timeval timeout;
-		timeout.tv_sec = 1;
-		timeout.tv_usec = 0;
+		timeout.tv_sec = cmd.frame_length / 1000;
+		timeout.tv_usec = (cmd.frame_length % 1000) * 1000;
 
 		rc = select(socket_max+1, &reads, 0, 0, &timeout);
 		exit_failure_if((rc < 0), "select() failed: %s", strerror(errno));
@@ -462,13 +740,22 @@ int main(int argc, char *argv[]) {
 						info(stdout, "send() failed: %s", strerror(errno));
 						FD_CLR(i, &master);
 						close(i);
-						continue;
+						break;
 					}
-					offset = offset + (sent / sizeof(int));
+					offset = offset + sent;
 					remaining = remaining - sent;
 				} while(remaining != 0);
 			}
-		}		
+		}
+
+		if (socket_group >= 0) {
+			rc = multicast_send(socket_group, &group_address, buf, buffer_size, sequence);
+			exit_failure_if((rc < 0), "multicast_send() failed");
+			sequence++;
+		}
+
+		if (shm != NULL)
+			shm_publish(shm, buf, buffer_size);
 	}
 
 	if (cmd.verbose)
@@ -480,7 +767,13 @@ int main(int argc, char *argv[]) {
 			close(i);
 		}
 	}
-	close(socket_listen);
+	if (socket_listen >= 0)
+		close(socket_listen);
+	if (socket_group >= 0)
+		close(socket_group);
+
+	if (shm != NULL)
+		shm_close(shm, shm_size);
 
 	sample_delete(sample);
 
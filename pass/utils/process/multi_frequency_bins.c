@@ -1,5 +1,7 @@
 // author john.d.sheehan@ie.ibm.com
 
+#include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,18 +15,30 @@
 #include "pass.h"
 
 
-const char *cmd_options_available = "c:e:h:o:p:r:s:u:v:";
+const char *cmd_options_available = "a:b:c:d:e:f:h:i:j:k:l:n:o:p:r:s:t:u:v:w:x:";
 
 const char *cmd_options_help = "\
+-a: averages (segments averaged into each welch estimate, default 1)\n\
+-b: band limited (0 - every bin of the frame, 1 - only the bins posted, default 0)\n\
 -c: channels (number of channels, default 1)\n\
+-d: hop (samples from one welch segment to the next, default half the segment)\n\
 -e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
 -h: has header (0 - no header, 1 - header, default 1)\n\
+-i: io_uring (0 - read, 1 - io_uring when the kernel supports it, default 0)\n\
+-j: workers (threads processing the channels of a frame, each with its own plan, default 1)\n\
+-k: checksum (0 - ignore, 1 - drop frames not matching the header checksum, default 0)\n\
+-l: planning level (0 - estimate, 1 - measure, 2 - patient, default 0)\n\
+-n: segment (samples per welch transform, 0 - one transform per frame, default 0)\n\
 -o: origin ip (default 127.0.0.1)\n\
 -p: port number (default 1234)\n\
 -r: sample rate (default 500000)\n\
 -s: sensors (number of sensors, default 1)\n\
+-t: threads (threads fftw runs each batch of transforms on, default 1)\n\
 -u: url (url frequency bins are posted to, default http://localhost:5100/data)\n\
--v: verbose\n";
+-v: verbose\n\
+-w: wisdom file (loaded on start, saved after planning, default none)\n\
+-x: single precision (0 - double, 1 - float32 through fftwf, default 0)\n";
 
 const char *sample_usage = "\
 sample args:\n\
@@ -33,7 +47,19 @@ listen to localhost:1234 for 1 sensor with 2 channels of endian swapped data con
 struct cmd_options {
 	int channels;
 	int endian_swap;
+	int frame_length;
 	int has_header;
+	int io_uring;
+	int checksum;
+	int single;
+	int planning;
+	int threads;
+	int workers;
+
+	int segment;
+	int hop;
+	int averages;
+	int band_limited;
 
 	int sample_rate;
 	int sensors;
@@ -42,12 +68,25 @@ struct cmd_options {
 	char port_number[16];
 	char server_name[256];
 	char url[256];
+	char wisdom[256];
 };
 
 static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->channels = 1;
 	cmd->endian_swap = 0;
+	cmd->frame_length = 1000;
 	cmd->has_header = 1;
+	cmd->io_uring = 0;
+	cmd->checksum = 0;
+	cmd->single = 0;
+	cmd->planning = 0;
+	cmd->threads = 1;
+	cmd->workers = 1;
+
+	cmd->segment = 0;
+	cmd->hop = 0;
+	cmd->averages = 1;
+	cmd->band_limited = 0;
 
 	cmd->sample_rate = 500000;
 	cmd->sensors = 1;
@@ -61,6 +100,8 @@ static void cmd_options_init(struct cmd_options *cmd) {
 
 	memset(cmd->url, '\0', sizeof(cmd->url));
 	strcpy(cmd->url, "http://localhost:5100/data");
+
+	memset(cmd->wisdom, '\0', sizeof(cmd->wisdom));
 }
 
 static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
@@ -74,10 +115,19 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 	int c;
 	while ((c = getopt(argc, argv, cmd_options_available)) != -1) {
 		switch(c) {
+			case 'a':  cmd->averages       = atoi(optarg);  break;
+			case 'b':  cmd->band_limited   = atoi(optarg);  break;
 			case 'c':  cmd->channels       = atoi(optarg);  break;
+			case 'd':  cmd->hop            = atoi(optarg);  break;
 			case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
 			case 'h':  cmd->has_header     = atoi(optarg);  break;
+			case 'i':  cmd->io_uring       = atoi(optarg);  break;
+			case 'j':  cmd->workers        = atoi(optarg);  break;
+			case 'k':  cmd->checksum       = atoi(optarg);  break;
+			case 'l':  cmd->planning       = atoi(optarg);  break;
 
+			case 'n':  cmd->segment        = atoi(optarg);  break;
 			case 'o':
 				if (strlen(optarg) < 255) {
 					strcpy(cmd->server_name, optarg);
@@ -92,6 +142,7 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 
 			case 'r':  cmd->sample_rate    = atoi(optarg);  break;
 			case 's':  cmd->sensors	= atoi(optarg);  break;
+			case 't':  cmd->threads        = atoi(optarg);  break;
 
 			case 'u':
 				if (strlen(optarg) < 255) {
@@ -100,6 +151,14 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 				break;
 
 			case 'v':  cmd->verbose	= atoi(optarg);  break;
+
+			case 'w':
+				if (strlen(optarg) < 255) {
+					strcpy(cmd->wisdom, optarg);
+				}
+				break;
+
+			case 'x':  cmd->single         = atoi(optarg);  break;
 			default:
 				flush(stdout, "%s\n", cmd_options_help);
 				flush(stdout, "%s\n", sample_usage);
@@ -109,17 +168,69 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 }
 
 static void cmd_options_print(struct cmd_options *cmd) {
+	flush(stdout, "[a] averages     : %d", cmd->averages);
+	flush(stdout, "[b] band limited : %d (%s)", cmd->band_limited, (cmd->band_limited == 1 ? "yes" : "no"));
 	flush(stdout, "[c] channels     : %d", cmd->channels);
+	flush(stdout, "[d] hop          : %d", cmd->hop);
 	flush(stdout, "[e] endian swap  : %d (%s)", cmd->endian_swap, (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length : %d ms", cmd->frame_length);
 
 	flush(stdout, "[h] has header   : %d (%s)", cmd->has_header, (cmd->has_header == 1 ? "yes" : "no"));
+	flush(stdout, "[i] io_uring     : %d (%s)", cmd->io_uring, (cmd->io_uring == 1 ? "yes" : "no"));
+	flush(stdout, "[j] workers      : %d", cmd->workers);
+	flush(stdout, "[k] checksum     : %d (%s)", cmd->checksum, (cmd->checksum == 1 ? "yes" : "no"));
+	flush(stdout, "[l] planning     : %d (%s)", cmd->planning, (cmd->planning == 2 ? "patient" : (cmd->planning == 1 ? "measure" : "estimate")));
+	flush(stdout, "[n] segment      : %d", cmd->segment);
 	flush(stdout, "[o] origin ip    : %s", cmd->server_name);
 	flush(stdout, "[p] port number  : %s", cmd->port_number);
 
 	flush(stdout, "[r] sample rate  : %d", cmd->sample_rate);
 	flush(stdout, "[s] sensors      : %d", cmd->sensors);
+	flush(stdout, "[t] threads      : %d", cmd->threads);
 	flush(stdout, "[u] url          : %s", cmd->url);
 	flush(stdout, "[v] verbose      : %d (%s)", cmd->verbose, (cmd->verbose == 1 ? "yes" : "no"));
+	flush(stdout, "[w] wisdom       : %s", (cmd->wisdom[0] != '\0') ? cmd->wisdom : "none");
+	flush(stdout, "[x] single       : %d (%s)", cmd->single, (cmd->single == 1 ? "yes" : "no"));
+}
+
+/* one frame, finished by the workers a sensor and channel at a time */
+struct frame_work {
+	const pass_context *pc;
+	pass_array *values;
+	pass_array *bins;       /* what is posted, one per sensor and channel */
+	pass_fftw_plan *plans;   /* one per worker, or the batched plan */
+	bool batched;            /* values already hold the power spectra */
+	pass_welch *welch;       /* one per sensor and channel, or NULL */
+	const char *url;
+
+	int bin_lower;
+	int bin_upper;
+	int bin_stride;
+};
+
+static void channel_process(void *data, int task, int worker) {
+	struct frame_work *work = data;
+	pass_array *v = &(work->values[task]);
+	pass_array *o = &(work->bins[task]);
+	pass_fftw_plan *plan = &(work->plans[work->batched ? 0 : worker]);
+
+	int sensor = task / work->pc->channel_count;
+	int channel = task % work->pc->channel_count;
+
+	if (work->welch != NULL) {
+		if (pass_welch_execute(&(work->welch[task]), v, plan) != PASS_SUCCESS)
+			return;
+	} else if (!work->batched) {
+		pass_fftw_execute(v, plan);
+	}
+
+	pass_frequency_bins(v, o, work->bin_lower, work->bin_upper, work->bin_stride);
+	pass_decibels(o, 1.0, 0.0);
+
+	char name[128];
+	snprintf(name, sizeof(name), "Sensor %d, Channel %d", sensor, channel);
+
+	pass_curl_post(work->url, o, name, "frequencybins", sensor, channel);
 }
 
 static volatile int proceed = 1;
@@ -146,26 +257,144 @@ int main(int argc, char **argv) {
 	pass_response pr;
 
 	pass_context pc;
-	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, cmd.has_header);
+	long frame_samples = ((long)(cmd.sample_rate) * cmd.frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd.frame_length, cmd.sample_rate, frame_samples);
+	int frame_size = (int)(frame_samples);
+	int flags = 0;
+	if (cmd.io_uring == 1)
+		flags |= PASS_FLAG_IO_URING;
+	if (cmd.checksum == 1)
+		flags |= PASS_FLAG_CHECKSUM;
+	if (cmd.endian_swap == 1)
+		flags |= PASS_FLAG_ENDIAN_SWAP;
+
+	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, frame_size, cmd.has_header, flags);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to init pass_context");
 
 	pass_array *values;
 	values = malloc(sizeof(pass_array) * pc.sensor_count * pc.channel_count);
 	exit_failure_if(values == NULL, "failed to allocate memory");
 	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
-		pr = pass_array_allocate(&values[i], pc.sample_rate);
+		if (cmd.single == 1)
+			pr = pass_array_allocate_single(&values[i], pc.frame_size);
+		else
+			pr = pass_array_allocate(&values[i], pc.frame_size);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	}
+
+	double *gradients = malloc(sizeof(double) * pc.sensor_count * pc.channel_count);
+	double *offsets = malloc(sizeof(double) * pc.sensor_count * pc.channel_count);
+	exit_failure_if((gradients == NULL) || (offsets == NULL), "failed to allocate memory");
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+		gradients[i] = gradient;
+		offsets[i] = offset;
+	}
+
+	if (cmd.wisdom[0] != '\0') {
+		pr = pass_fftw_wisdom(cmd.wisdom);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to set wisdom file");
+	}
+
+	if (cmd.threads > 1) {
+		pr = pass_fftw_threads(cmd.threads);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to init fftw threads");
+	}
+
+	int plan_flags = 0;
+	if (cmd.single == 1)
+		plan_flags |= PASS_PLAN_SINGLE;
+	if (cmd.planning == 1)
+		plan_flags |= PASS_PLAN_MEASURE;
+	if (cmd.planning == 2)
+		plan_flags |= PASS_PLAN_PATIENT;
+
+	/* welch segments replace the frame as the transform */
+	pass_welch *welch = NULL;
+	int transform_size = pc.frame_size;
+	if (cmd.segment > 0) {
+		exit_failure_if(cmd.single == 1, "welch averaging is double precision only");
+
+		if (cmd.hop <= 0)
+			cmd.hop = (cmd.segment > 1) ? cmd.segment / 2 : 1;
+
+		welch = malloc(sizeof(pass_welch) * pc.sensor_count * pc.channel_count);
+		exit_failure_if(welch == NULL, "failed to allocate memory");
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+			pr = pass_welch_init(&welch[i], cmd.segment, cmd.hop, cmd.averages);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to init welch averaging");
+		}
+
+		transform_size = cmd.segment;
+	}
+
+	// 1 Hz to 1000 Hz in 5 Hz steps, as bins of the transform
+	int bin_lower  = (int)(((long)(1) * transform_size) / pc.sample_rate);
+	int bin_upper  = (int)(((long)(1000) * transform_size) / pc.sample_rate);
+	int bin_stride = (int)(((long)(5) * transform_size) / pc.sample_rate);
+	if (bin_lower < 1)
+		bin_lower = 1;
+	if (bin_stride < 1)
+		bin_stride = 1;
+
+	int bin_count = ((bin_upper - bin_lower) + bin_stride - 1) / bin_stride;
+
+	pass_array *bins = malloc(sizeof(pass_array) * pc.sensor_count * pc.channel_count);
+	exit_failure_if(bins == NULL, "failed to allocate memory");
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+		if (cmd.single == 1)
+			pr = pass_array_allocate_single(&bins[i], bin_count);
+		else
+			pr = pass_array_allocate(&bins[i], bin_count);
 		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
 	}
 
-	pass_fftw_plan pass_plan;
-	pr = pass_fftw_plan_init(&pass_plan, pc.sample_rate);
-	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	/* only the bins grouped into frequency bins are needed */
+	double lowest = ((double)(bin_lower) * pc.sample_rate) / transform_size;
+	double highest = ((double)(bin_upper + bin_stride) * pc.sample_rate) / transform_size;
+
+	/* a single worker transforms the whole frame in one batch, more each get a plan */
+	bool pruned = (cmd.band_limited == 1) && (welch == NULL);
+	bool batched = (cmd.workers <= 1) && (welch == NULL) && (!pruned);
+	if (pruned && (cmd.workers <= 1))
+		info(stdout, "-b 1: pruned plans are not batched, -b 0 batches the transforms of a single worker");
+	if (pruned && (cmd.single == 1))
+		info(stdout, "-b 1: pruned plans transform in double, only the arrays are float32");
+	int plan_count = (cmd.workers > 1) ? cmd.workers : 1;
+	pass_fftw_plan *plans = malloc(sizeof(pass_fftw_plan) * plan_count);
+	exit_failure_if(plans == NULL, "failed to allocate memory");
+
+	if (!batched) {
+		for (int i = 0; i < plan_count; i++) {
+			if (pruned)
+				pr = pass_fftw_plan_init_pruned(&plans[i], pc.sample_rate, transform_size, lowest, highest, plan_flags);
+			else
+				pr = pass_fftw_plan_init(&plans[i], pc.sample_rate, transform_size, plan_flags);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+		}
+	} else {
+		pr = pass_fftw_plan_init_many(&plans[0], pc.sample_rate, pc.frame_size, pc.sensor_count * pc.channel_count, plan_flags);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	}
+
+	pass_pool pool;
+	pr = pass_pool_init(&pool, plan_count);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to start workers");
 
 	pr = pass_curl_init();
 	exit_failure_if(pr != PASS_SUCCESS, "failed to init curl");
 
-	char *name_buffer = malloc(128);
-	exit_failure_if(name_buffer == NULL, "failed to allocate memeory");
+	struct frame_work work = {
+		.pc = &pc,
+		.values = values,
+		.bins = bins,
+		.plans = plans,
+		.batched = batched,
+		.welch = welch,
+		.url = cmd.url,
+		.bin_lower = bin_lower,
+		.bin_upper = bin_upper,
+		.bin_stride = bin_stride,
+	};
 
 	pr = pass_connect(&pc, cmd.server_name, cmd.port_number);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to connect");
@@ -173,51 +402,52 @@ int main(int argc, char **argv) {
 	while ((proceed) &&
 	      ((pr = pass_read(&pc)) == PASS_SUCCESS)) {
 
-		if (cmd.has_header) {
-			pr = pass_gaps_detection(&pc);
+		/* a read can complete more than one frame, each is taken in turn */
+		while ((proceed) &&
+		      ((pr = pass_gaps_detection(&pc)) != PASS_FAILURE_NO_DATA)) {
+
+			if (pr == PASS_FAILURE_CHECKSUM) {
+				info(stdout, "frame %lu failed the checksum, dropped", (unsigned long)pc.sequence_id);
+				continue;
+			}
 			if (pr != PASS_SUCCESS) {
 				info(stdout, "gap detected");
 				continue;
 			}
-		}
 
-		if (cmd.endian_swap)
-			pass_endian_swap(&pc);
-
-		for (int i = 0, k = 0; i < pc.sensor_count; i++) {
-			for (int j = 0; j < pc.channel_count; j++) {
-				pass_array *v = &values[k];
-
-				k++;
-
-				pass_convert_to_doubles(v, &pc, i, j, gradient, offset);
-				pass_fftw_execute(v, &pass_plan);
-				pass_frequency_bins(v, 1, 1000, 5);
-				pass_decibels(v, 1.0, 0.0);
-
-				memset(name_buffer, '\0', 128);
-				snprintf(name_buffer, 127, "Sensor %d, Channel %d", i, j);
-				
-				pass_curl_post(
-					cmd.url,
-					v,
-					name_buffer,
-					"frequencybins",
-					i,
-					j);
-			}
+			if (work.batched)
+				pass_fftw_execute_many(values, &pc, &plans[0], gradients, offsets);
+			else
+				pass_deinterleave(values, &pc, gradients, offsets);
+
+			pass_pool_run(&pool, channel_process, &work, pc.sensor_count * pc.channel_count);
 		}
 	}
 
+	if (pc.frames_lost != 0)
+		info(stdout, "lost %lu frames, %lu fragments", (unsigned long)pc.frames_lost, (unsigned long)pc.fragments_lost);
+	if (pc.frames_corrupt != 0)
+		info(stdout, "dropped %lu frames failing the checksum", (unsigned long)pc.frames_corrupt);
+
 	pass_close(&pc);
 
-	free(name_buffer);
+	pr = pass_pool_term(&pool);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to stop workers");
 
 	pr = pass_curl_term();
 	exit_failure_if(pr != PASS_SUCCESS, "failed to release curl");
 
-	pr = pass_fftw_plan_term(&pass_plan);
-	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	for (int i = 0; i < plan_count; i++) {
+		pr = pass_fftw_plan_term(&plans[i]);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	}
+	free(plans);
+
+	if (welch != NULL) {
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++)
+			pass_welch_term(&welch[i]);
+		free(welch);
+	}
 
 	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++ ) {
 		pr = pass_array_free(&values[i]);
@@ -225,6 +455,14 @@ int main(int argc, char **argv) {
 	}
 	free(values);
 
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++ ) {
+		pr = pass_array_free(&bins[i]);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	}
+	free(bins);
+	free(gradients);
+	free(offsets);
+
 	pr = pass_context_free(&pc);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
 
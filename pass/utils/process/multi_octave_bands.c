@@ -1,5 +1,7 @@
 // author john.d.sheehan@ie.ibm.com
 
+#include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,18 +13,35 @@
 #include "pass.h"
 
 
-const char *cmd_options_available = "c:e:h:o:p:r:s:u:v:";
+const char *cmd_options_available = "a:b:c:d:e:f:g:h:i:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:";
 
 const char *cmd_options_help = "\
+-a: averages (segments averaged into each welch estimate, default 1)\n\
+-b: band limited (0 - every bin of the frame, 1 - only the bins up to 4 kHz, default 0)\n\
 -c: channels (number of channels, default 1)\n\
+-d: hop (samples from one welch segment to the next, default half the segment)\n\
 -e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
+-g: fraction (1 - octave bands, 3 - third octave bands, n - 1/n octave bands, default 3)\n\
 -h: has header (0 - no header, 1 - header, default 1)\n\
+-i: io_uring (0 - read, 1 - io_uring when the kernel supports it, default 0)\n\
+-j: workers (threads processing the channels of a frame, each with its own plan, default 1)\n\
+-k: checksum (0 - ignore, 1 - drop frames not matching the header checksum, default 0)\n\
+-l: planning level (0 - estimate, 1 - measure, 2 - patient, default 0)\n\
+-m: multirate (0 - bands from the frame's transform, 1 - octave bank, each band at the lowest rate that holds it, 2 - iir filter bank, default 0)\n\
+-n: segment (samples per welch transform, 0 - one transform per frame, default 0)\n\
 -o: origin ip (default 127.0.0.1)\n\
 -p: port number (default 1234)\n\
+-q: time weighting (of the iir filter bank and the summaries, 0 - none, each frame as it is, 1 - fast, 2 - slow, default 0)\n\
 -r: sample rate (default 500000)\n\
 -s: sensors (number of sensors, default 1)\n\
+-t: threads (threads fftw runs each batch of transforms on, default 1)\n\
 -u: url (url octave bands are posted to, default http://localhost:5100/data)\n\
--v: verbose\n";
+-v: verbose\n\
+-w: wisdom file (loaded on start, saved after planning, default none)\n\
+-x: single precision (0 - double, 1 - float32 through fftwf, default 0)\n\
+-y: weighting (0 - Z, 1 - A, 2 - C, default 0)\n\
+-z: summary interval (seconds of Leq, Lmax and Lmin in each post instead of every frame's bands, 0 - every frame, default 0)\n";
 
 const char *sample_usage = "\
 sample args:\n\
@@ -31,7 +50,24 @@ listen to localhost:1234 for 1 sensor with 2 channels of endian swapped data con
 struct cmd_options {
 	int channels;
 	int endian_swap;
+	int frame_length;
 	int has_header;
+	int io_uring;
+	int checksum;
+	int single;
+	int planning;
+	int threads;
+	int workers;
+
+	int segment;
+	int hop;
+	int averages;
+	int band_limited;
+	int multirate;
+	int fraction;
+	int weighting;
+	int frequency_weighting;
+	double interval;
 
 	int sample_rate;
 	int sensors;
@@ -40,12 +76,30 @@ struct cmd_options {
 	char port_number[16];
 	char server_name[256];
 	char url[256];
+	char wisdom[256];
 };
 
 static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->channels = 1;
 	cmd->endian_swap = 0;
+	cmd->frame_length = 1000;
 	cmd->has_header = 1;
+	cmd->io_uring = 0;
+	cmd->checksum = 0;
+	cmd->single = 0;
+	cmd->planning = 0;
+	cmd->threads = 1;
+	cmd->workers = 1;
+
+	cmd->segment = 0;
+	cmd->hop = 0;
+	cmd->averages = 1;
+	cmd->band_limited = 0;
+	cmd->multirate = 0;
+	cmd->fraction = 3;
+	cmd->weighting = 0;
+	cmd->frequency_weighting = PASS_WEIGHTING_Z;
+	cmd->interval = 0.0;
 
 	cmd->sample_rate = 500000;
 	cmd->sensors = 1;
@@ -59,6 +113,8 @@ static void cmd_options_init(struct cmd_options *cmd) {
 
 	memset(cmd->url, '\0', sizeof(cmd->url));
 	strcpy(cmd->url, "http://localhost:5100/data");
+
+	memset(cmd->wisdom, '\0', sizeof(cmd->wisdom));
 }
 
 static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
@@ -72,10 +128,21 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 	int c;
 	while ((c = getopt(argc, argv, cmd_options_available)) != -1) {
 		switch(c) {
+			case 'a':  cmd->averages       = atoi(optarg);  break;
+			case 'b':  cmd->band_limited   = atoi(optarg);  break;
 			case 'c':  cmd->channels       = atoi(optarg);  break;
+			case 'd':  cmd->hop            = atoi(optarg);  break;
 			case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
+			case 'g':  cmd->fraction       = atoi(optarg);  break;
 			case 'h':  cmd->has_header     = atoi(optarg);  break;
+			case 'i':  cmd->io_uring       = atoi(optarg);  break;
+			case 'j':  cmd->workers        = atoi(optarg);  break;
+			case 'k':  cmd->checksum       = atoi(optarg);  break;
+			case 'l':  cmd->planning       = atoi(optarg);  break;
 
+			case 'm':  cmd->multirate      = atoi(optarg);  break;
+			case 'n':  cmd->segment        = atoi(optarg);  break;
 			case 'o':
 				if (strlen(optarg) < 255) {
 					strcpy(cmd->server_name, optarg);
@@ -88,8 +155,10 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 				}
 				break;
 
+			case 'q':  cmd->weighting      = atoi(optarg);  break;
 			case 'r':  cmd->sample_rate    = atoi(optarg);  break;
 			case 's':  cmd->sensors	= atoi(optarg);  break;
+			case 't':  cmd->threads        = atoi(optarg);  break;
 
 			case 'u':
 				if (strlen(optarg) < 255) {
@@ -98,6 +167,16 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 				break;
 
 			case 'v':  cmd->verbose	= atoi(optarg);  break;
+
+			case 'w':
+				if (strlen(optarg) < 255) {
+					strcpy(cmd->wisdom, optarg);
+				}
+				break;
+
+			case 'x':  cmd->single         = atoi(optarg);  break;
+			case 'y':  cmd->frequency_weighting = atoi(optarg);  break;
+			case 'z':  cmd->interval       = atof(optarg);  break;
 			default:
 				flush(stdout, "%s\n", cmd_options_help);
 				flush(stdout, "%s\n", sample_usage);
@@ -107,17 +186,117 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 }
 
 static void cmd_options_print(struct cmd_options *cmd) {
+	flush(stdout, "[a] averages     : %d", cmd->averages);
+	flush(stdout, "[b] band limited : %d (%s)", cmd->band_limited, (cmd->band_limited == 1 ? "yes" : "no"));
 	flush(stdout, "[c] channels     : %d", cmd->channels);
+	flush(stdout, "[d] hop          : %d", cmd->hop);
 	flush(stdout, "[e] endian swap  : %d (%s)", cmd->endian_swap, (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length : %d ms", cmd->frame_length);
+	flush(stdout, "[g] fraction     : 1/%d octave", cmd->fraction);
 
 	flush(stdout, "[h] has header   : %d (%s)", cmd->has_header, (cmd->has_header == 1 ? "yes" : "no"));
+	flush(stdout, "[i] io_uring     : %d (%s)", cmd->io_uring, (cmd->io_uring == 1 ? "yes" : "no"));
+	flush(stdout, "[j] workers      : %d", cmd->workers);
+	flush(stdout, "[k] checksum     : %d (%s)", cmd->checksum, (cmd->checksum == 1 ? "yes" : "no"));
+	flush(stdout, "[l] planning     : %d (%s)", cmd->planning, (cmd->planning == 2 ? "patient" : (cmd->planning == 1 ? "measure" : "estimate")));
+	flush(stdout, "[m] multirate    : %d (%s)", cmd->multirate, (cmd->multirate == 2 ? "iir" : (cmd->multirate == 1 ? "yes" : "no")));
+	flush(stdout, "[n] segment      : %d", cmd->segment);
 	flush(stdout, "[o] origin ip    : %s", cmd->server_name);
 	flush(stdout, "[p] port number  : %s", cmd->port_number);
+	flush(stdout, "[q] weighting    : %d (%s)", cmd->weighting, (cmd->weighting == 2 ? "slow" : (cmd->weighting == 1 ? "fast" : "frame")));
 
 	flush(stdout, "[r] sample rate  : %d", cmd->sample_rate);
 	flush(stdout, "[s] sensors      : %d", cmd->sensors);
+	flush(stdout, "[t] threads      : %d", cmd->threads);
 	flush(stdout, "[u] url	  : %s", cmd->url);
 	flush(stdout, "[v] verbose      : %d (%s)", cmd->verbose, (cmd->verbose == 1 ? "yes" : "no"));
+	flush(stdout, "[w] wisdom       : %s", (cmd->wisdom[0] != '\0') ? cmd->wisdom : "none");
+	flush(stdout, "[x] single       : %d (%s)", cmd->single, (cmd->single == 1 ? "yes" : "no"));
+	flush(stdout, "[y] weighting    : %d (%s)", cmd->frequency_weighting, (cmd->frequency_weighting == PASS_WEIGHTING_C ? "C" : (cmd->frequency_weighting == PASS_WEIGHTING_A ? "A" : "Z")));
+	flush(stdout, "[z] interval     : %.03f s", cmd->interval);
+}
+
+/* one frame, finished by the workers a sensor and channel at a time */
+struct frame_work {
+	const pass_context *pc;
+	pass_array *values;
+	pass_array *bands;       /* what is posted, one per sensor and channel */
+	pass_fftw_plan *plans;   /* one per worker, or the batched plan */
+	bool batched;            /* values already hold the power spectra */
+	pass_welch *welch;       /* one per sensor and channel, or NULL */
+	pass_octave_bank *bank;  /* one per sensor and channel, or NULL */
+	pass_iir_bank *iir;      /* one for every sensor and channel, or NULL */
+	pass_meter *meter;       /* one per sensor and channel, or NULL to post every frame */
+	pass_array *extremes;    /* mean square, highest and lowest from the iir bank, three per sensor and channel, or NULL */
+	double seconds;          /* of samples behind each set of bands */
+	int lower;               /* posted bands, lower to upper - 1 */
+	int upper;
+	const char *url;
+};
+
+static void channel_process(void *data, int task, int worker) {
+	struct frame_work *work = data;
+	pass_array *v = &(work->values[task]);
+	pass_array *o = &(work->bands[task]);
+	pass_fftw_plan *plan = &(work->plans[work->batched ? 0 : worker]);
+
+	int sensor = task / work->pc->channel_count;
+	int channel = task % work->pc->channel_count;
+
+	if (work->bank != NULL) {
+		if (pass_octave_bank_execute(&(work->bank[task]), v, o) != PASS_SUCCESS)
+			return;
+	} else if (work->iir != NULL) {
+		/* the bank has filtered every channel before the workers start */
+	} else {
+		if (work->welch != NULL) {
+			if (pass_welch_execute(&(work->welch[task]), v, plan) != PASS_SUCCESS)
+				return;
+		} else if (!work->batched) {
+			pass_fftw_execute(v, plan);
+		}
+
+		pass_octave_bands(v, o, plan, work->lower, work->upper);
+	}
+
+	char name[128];
+
+	if (work->meter != NULL) {
+		pass_meter *meter = &(work->meter[task]);
+		pass_response pr;
+
+		/* the iir bank weights each sample, so its own extremes and unweighted mean squares go to the meter */
+		if (work->extremes != NULL) {
+			pass_array *e = &(work->extremes[3 * task]);
+
+			pass_iir_bank_extremes(work->iir, task, &e[0], &e[1], &e[2]);
+			pr = pass_meter_execute_weighted(meter, &e[0], &e[1], &e[2], work->seconds);
+		} else {
+			pr = pass_meter_execute(meter, o, work->seconds);
+		}
+
+		if (pr != PASS_SUCCESS)
+			return;
+
+		pass_decibels(&(meter->leq), 1.0, 0.0);
+		pass_decibels(&(meter->lmax), 1.0, 0.0);
+		pass_decibels(&(meter->lmin), 1.0, 0.0);
+
+		snprintf(name, sizeof(name), "Sensor %d, Channel %d, Leq", sensor, channel);
+		pass_curl_post(work->url, &(meter->leq), name, "octavebands", sensor, channel);
+		snprintf(name, sizeof(name), "Sensor %d, Channel %d, Lmax", sensor, channel);
+		pass_curl_post(work->url, &(meter->lmax), name, "octavebands", sensor, channel);
+		snprintf(name, sizeof(name), "Sensor %d, Channel %d, Lmin", sensor, channel);
+		pass_curl_post(work->url, &(meter->lmin), name, "octavebands", sensor, channel);
+
+		return;
+	}
+
+	pass_decibels(o, 1.0, 0.0);
+
+	snprintf(name, sizeof(name), "Sensor %d, Channel %d", sensor, channel);
+
+	pass_curl_post(work->url, o, name, "octavebands", sensor, channel);
 }
 
 static volatile int proceed = 1;
@@ -144,26 +323,216 @@ int main(int argc, char **argv) {
 	pass_response pr;
 
 	pass_context pc;
-	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, cmd.has_header);
+	long frame_samples = ((long)(cmd.sample_rate) * cmd.frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd.frame_length, cmd.sample_rate, frame_samples);
+	int frame_size = (int)(frame_samples);
+	int flags = 0;
+	if (cmd.io_uring == 1)
+		flags |= PASS_FLAG_IO_URING;
+	if (cmd.checksum == 1)
+		flags |= PASS_FLAG_CHECKSUM;
+	if (cmd.endian_swap == 1)
+		flags |= PASS_FLAG_ENDIAN_SWAP;
+
+	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, frame_size, cmd.has_header, flags);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to init pass_context");
 
 	pass_array *values;
 	values = malloc(sizeof(pass_array) * pc.sensor_count * pc.channel_count);
 	exit_failure_if(values == NULL, "failed to allocate memory");
 	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
-		pr = pass_array_allocate(&values[i], pc.sample_rate);
+		if (cmd.single == 1)
+			pr = pass_array_allocate_single(&values[i], pc.frame_size);
+		else
+			pr = pass_array_allocate(&values[i], pc.frame_size);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	}
+
+	/* the bands from 10 Hz to 4 kHz, 10 to 35 for third octaves */
+	exit_failure_if(cmd.fraction < 1, "invalid fraction");
+	int lower = pass_octave_band_number(cmd.fraction, 10.0);
+	int upper = pass_octave_band_number(cmd.fraction, pow(10.0, 3.6));
+
+	pass_array *bands = malloc(sizeof(pass_array) * pc.sensor_count * pc.channel_count);
+	exit_failure_if(bands == NULL, "failed to allocate memory");
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+		if (cmd.single == 1)
+			pr = pass_array_allocate_single(&bands[i], upper - lower);
+		else
+			pr = pass_array_allocate(&bands[i], upper - lower);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	}
+
+	double *gradients = malloc(sizeof(double) * pc.sensor_count * pc.channel_count);
+	double *offsets = malloc(sizeof(double) * pc.sensor_count * pc.channel_count);
+	exit_failure_if((gradients == NULL) || (offsets == NULL), "failed to allocate memory");
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+		gradients[i] = gradient;
+		offsets[i] = offset;
+	}
+
+	if (cmd.wisdom[0] != '\0') {
+		pr = pass_fftw_wisdom(cmd.wisdom);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to set wisdom file");
+	}
+
+	if (cmd.threads > 1) {
+		pr = pass_fftw_threads(cmd.threads);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to init fftw threads");
+	}
+
+	int plan_flags = 0;
+	if (cmd.single == 1)
+		plan_flags |= PASS_PLAN_SINGLE;
+	if (cmd.planning == 1)
+		plan_flags |= PASS_PLAN_MEASURE;
+	if (cmd.planning == 2)
+		plan_flags |= PASS_PLAN_PATIENT;
+
+	/* welch segments replace the frame as the transform */
+	pass_welch *welch = NULL;
+	int transform_size = pc.frame_size;
+	if (cmd.segment > 0) {
+		exit_failure_if(cmd.single == 1, "welch averaging is double precision only");
+
+		if (cmd.hop <= 0)
+			cmd.hop = (cmd.segment > 1) ? cmd.segment / 2 : 1;
+
+		welch = malloc(sizeof(pass_welch) * pc.sensor_count * pc.channel_count);
+		exit_failure_if(welch == NULL, "failed to allocate memory");
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+			pr = pass_welch_init(&welch[i], cmd.segment, cmd.hop, cmd.averages);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to init welch averaging");
+		}
+
+		transform_size = cmd.segment;
+	}
+
+	/* the bank keeps its own transforms, one per level */
+	pass_octave_bank *bank = NULL;
+	if (cmd.multirate == 1) {
+		exit_failure_if((cmd.single == 1) || (welch != NULL), "the octave bank is double precision, without welch averaging");
+		exit_failure_if(cmd.fraction != 3, "the octave bank measures third octave bands only");
+
+		bank = malloc(sizeof(pass_octave_bank) * pc.sensor_count * pc.channel_count);
+		exit_failure_if(bank == NULL, "failed to allocate memory");
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+			pr = pass_octave_bank_init(&bank[i], pc.sample_rate, pc.frame_size, lower, upper, cmd.frequency_weighting);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to init octave bank");
+		}
+	}
+
+	/* as does the iir bank, its filters keep their state from frame to frame */
+	pass_iir_bank *iir = NULL;
+	if (cmd.multirate == 2) {
+		exit_failure_if(welch != NULL, "the iir filter bank runs without welch averaging");
+		exit_failure_if(cmd.fraction != 3, "the iir filter bank measures third octave bands only");
+
+		double time_constant = (cmd.weighting == 2) ? 1.0 : ((cmd.weighting == 1) ? 0.125 : 0.0);
+
+		iir = malloc(sizeof(pass_iir_bank));
+		exit_failure_if(iir == NULL, "failed to allocate memory");
+		pr = pass_iir_bank_init(iir, pc.sample_rate, pc.frame_size, pc.sensor_count * pc.channel_count, lower, upper, time_constant, cmd.frequency_weighting);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to init iir filter bank");
+	}
+	bool planless = (bank != NULL) || (iir != NULL);
+
+	/* nothing above the upper edge of third octave band 36 is posted, whatever the fraction */
+	double lowest = 0.0;
+	double highest = pow(10.0, (36 + 0.5) / 10.0);
+
+	/* a single worker transforms the whole frame in one batch, more each get a plan */
+	bool pruned = (cmd.band_limited == 1) && (welch == NULL);
+	bool batched = (cmd.workers <= 1) && (welch == NULL) && (!planless) && (!pruned);
+	if (pruned && (cmd.workers <= 1) && (!planless))
+		info(stdout, "-b 1: pruned plans are not batched, -b 0 batches the transforms of a single worker");
+	if (pruned && (cmd.single == 1) && (!planless))
+		info(stdout, "-b 1: pruned plans transform in double, only the arrays are float32");
+	int plan_count = (cmd.workers > 1) ? cmd.workers : 1;
+	pass_fftw_plan *plans = malloc(sizeof(pass_fftw_plan) * plan_count);
+	exit_failure_if(plans == NULL, "failed to allocate memory");
+
+	if (planless) {
+		/* no plans, the workers split the octave banks and post */
+	} else if (!batched) {
+		for (int i = 0; i < plan_count; i++) {
+			if (pruned)
+				pr = pass_fftw_plan_init_pruned(&plans[i], pc.sample_rate, transform_size, lowest, highest, plan_flags);
+			else
+				pr = pass_fftw_plan_init(&plans[i], pc.sample_rate, transform_size, plan_flags);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+		}
+	} else {
+		pr = pass_fftw_plan_init_many(&plans[0], pc.sample_rate, pc.frame_size, pc.sensor_count * pc.channel_count, plan_flags);
 		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
 	}
 
-	pass_fftw_plan pass_plan;
-	pr = pass_fftw_plan_init(&pass_plan, pc.sample_rate);
-	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	if ((!planless) && (cmd.fraction != 3)) {
+		for (int i = 0; i < (batched ? 1 : plan_count); i++) {
+			pr = pass_fftw_plan_bands(&plans[i], cmd.fraction);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to generate bands");
+		}
+	}
+
+	if ((!planless) && (cmd.frequency_weighting != PASS_WEIGHTING_Z)) {
+		for (int i = 0; i < (batched ? 1 : plan_count); i++) {
+			pr = pass_fftw_plan_weighting(&plans[i], cmd.frequency_weighting);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to weight bands");
+		}
+	}
+
+	/* summaries time weight the bands a frame at a time, the iir bank has weighted them already */
+	pass_meter *meter = NULL;
+	pass_array *extremes = NULL;
+	double seconds = (double)(pc.frame_size) / pc.sample_rate;
+	if ((welch != NULL) && (cmd.hop * cmd.averages > pc.frame_size))
+		seconds = (double)(cmd.hop) * cmd.averages / pc.sample_rate;
+
+	if (cmd.interval > 0.0) {
+		double time_constant = (cmd.weighting == 2) ? 1.0 : ((cmd.weighting == 1) ? 0.125 : 0.0);
+		if (iir != NULL)
+			time_constant = 0.0;
+
+		meter = malloc(sizeof(pass_meter) * pc.sensor_count * pc.channel_count);
+		exit_failure_if(meter == NULL, "failed to allocate memory");
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
+			pr = pass_meter_init(&meter[i], upper - lower, cmd.interval, time_constant);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to init meter");
+		}
+
+		if (iir != NULL) {
+			extremes = malloc(sizeof(pass_array) * 3 * pc.sensor_count * pc.channel_count);
+			exit_failure_if(extremes == NULL, "failed to allocate memory");
+			for (int i = 0; i < (3 * pc.sensor_count * pc.channel_count); i++) {
+				pr = pass_array_allocate(&extremes[i], upper - lower);
+				exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+			}
+		}
+	}
+
+	pass_pool pool;
+	pr = pass_pool_init(&pool, plan_count);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to start workers");
 
 	pr = pass_curl_init();
 	exit_failure_if(pr != PASS_SUCCESS, "failed to init curl");
 
-	char *name_buffer = malloc(128);
-	exit_failure_if(name_buffer == NULL, "failed to allocate memory");
+	struct frame_work work = {
+		.pc = &pc,
+		.values = values,
+		.bands = bands,
+		.plans = plans,
+		.batched = batched,
+		.welch = welch,
+		.bank = bank,
+		.iir = iir,
+		.meter = meter,
+		.extremes = extremes,
+		.seconds = seconds,
+		.lower = lower,
+		.upper = upper,
+		.url = cmd.url,
+	};
 
 	pr = pass_connect(&pc, cmd.server_name, cmd.port_number);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to connect");
@@ -171,51 +540,81 @@ int main(int argc, char **argv) {
 	while ((proceed) &&
 	      ((pr = pass_read(&pc)) == PASS_SUCCESS)) {
 
-		if (cmd.has_header) {
-			pr = pass_gaps_detection(&pc);
+		/* a read can complete more than one frame, each is taken in turn */
+		while ((proceed) &&
+		      ((pr = pass_gaps_detection(&pc)) != PASS_FAILURE_NO_DATA)) {
+
+			if (pr == PASS_FAILURE_CHECKSUM) {
+				info(stdout, "frame %lu failed the checksum, dropped", (unsigned long)pc.sequence_id);
+				continue;
+			}
 			if (pr != PASS_SUCCESS) {
 				info(stdout, "gap detected");
 				continue;
 			}
-		}
 
-		if (cmd.endian_swap)
-			pass_endian_swap(&pc);
+			if (work.batched)
+				pass_fftw_execute_many(values, &pc, &plans[0], gradients, offsets);
+			else
+				pass_deinterleave(values, &pc, gradients, offsets);
 
-		for (int i = 0, k = 0; i < pc.sensor_count; i++) {
-			for (int j = 0; j < pc.channel_count; j++) {
-				pass_array *v = &values[k];
+			/* one pass of the iir bank filters every channel, the workers then post */
+			if (iir != NULL)
+				pass_iir_bank_execute(iir, values, bands);
 
-				k++;
-
-				pass_convert_to_doubles(v, &pc, i, j, gradient, offset);
-				pass_fftw_execute(v, &pass_plan);
-				pass_octave_bands(v, 10, 36);
-				pass_decibels(v, 1.0, 0.0);
-
-				memset(name_buffer, '\0', 128);
-				snprintf(name_buffer, 127, "Sensor %d, Channel %d", i, j);
-
-				pass_curl_post(
-					cmd.url,
-					v,
-					name_buffer,
-					"octavebands",
-					i,
-					j);
-			}
+			pass_pool_run(&pool, channel_process, &work, pc.sensor_count * pc.channel_count);
 		}
 	}
 
+	if (pc.frames_lost != 0)
+		info(stdout, "lost %lu frames, %lu fragments", (unsigned long)pc.frames_lost, (unsigned long)pc.fragments_lost);
+	if (pc.frames_corrupt != 0)
+		info(stdout, "dropped %lu frames failing the checksum", (unsigned long)pc.frames_corrupt);
+
 	pass_close(&pc);
 
-	free(name_buffer);
+	pr = pass_pool_term(&pool);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to stop workers");
 
 	pr = pass_curl_term();
 	exit_failure_if(pr != PASS_SUCCESS, "failed to release curl");
 
-	pr = pass_fftw_plan_term(&pass_plan);
-	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	for (int i = 0; (!planless) && (i < plan_count); i++) {
+		pr = pass_fftw_plan_term(&plans[i]);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	}
+	free(plans);
+
+	if (bank != NULL) {
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++)
+			pass_octave_bank_term(&bank[i]);
+		free(bank);
+	}
+
+	if (iir != NULL) {
+		pass_iir_bank_term(iir);
+		free(iir);
+	}
+
+	if (meter != NULL) {
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++)
+			pass_meter_term(&meter[i]);
+		free(meter);
+	}
+
+	if (extremes != NULL) {
+		for (int i = 0; i < (3 * pc.sensor_count * pc.channel_count); i++) {
+			pr = pass_array_free(&extremes[i]);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+		}
+		free(extremes);
+	}
+
+	if (welch != NULL) {
+		for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++)
+			pass_welch_term(&welch[i]);
+		free(welch);
+	}
 
 	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++ ) {
 		pr = pass_array_free(&values[i]);
@@ -223,6 +622,14 @@ int main(int argc, char **argv) {
 	}
 	free(values);
 
+	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++ ) {
+		pr = pass_array_free(&bands[i]);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	}
+	free(bands);
+	free(gradients);
+	free(offsets);
+
 	pr = pass_context_free(&pc);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
 
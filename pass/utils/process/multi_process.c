@@ -0,0 +1,616 @@
+// author john.d.sheehan@ie.ibm.com
+
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string.h>
+#include <time.h>
+
+#include "macros.h"
+#include "pass.h"
+
+
+const char *cmd_options_available = "a:b:c:d:e:f:g:h:i:j:k:l:n:o:p:r:s:t:u:v:w:x:y:z:";
+
+const char *cmd_options_help = "\
+-a: averages (segments averaged into each welch estimate, default 1)\n\
+-b: band limited (0 - every bin of the frame, 1 - only the bins posted, default 0)\n\
+-c: channels (number of channels, default 1)\n\
+-d: hop (samples from one welch segment to the next, default half the segment)\n\
+-e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
+-g: fraction (1 - octave bands, 3 - third octave bands, n - 1/n octave bands, default 3)\n\
+-h: has header (0 - no header, 1 - header, default 1)\n\
+-i: io_uring (0 - read, 1 - io_uring when the kernel supports it, default 0)\n\
+-j: workers (threads processing the channels of a frame, each with its own plan, default 1)\n\
+-k: checksum (0 - ignore, 1 - drop frames not matching the header checksum, default 0)\n\
+-l: planning level (0 - estimate, 1 - measure, 2 - patient, default 0)\n\
+-n: segment (samples per welch transform, 0 - one transform per frame, default 0)\n\
+-o: origin ip (default 127.0.0.1)\n\
+-p: port number (default 1234)\n\
+-r: sample rate (default 500000)\n\
+-s: sensors (number of sensors, default 1)\n\
+-t: threads (threads fftw runs each batch of transforms on, default 1)\n\
+-u: url (url octave bands and frequency bins are posted to, default http://localhost:5100/data)\n\
+-v: verbose\n\
+-w: wisdom file (loaded on start, saved after planning, default none)\n\
+-x: single precision (0 - double, 1 - float32 through fftwf, default 0)\n\
+-y: outputs (any of o - octave bands, b - frequency bins, w - wav files, default obw)\n\
+-z: duration (duration of wav files, default 60 seconds)\n";
+
+const char *sample_usage = "\
+sample args:\n\
+listen to localhost:1234 for 1 sensor with 2 channels, posting octave bands and frequency bins and writing wav files of 10 minutes: -o localhost -p 1234 -s 1 -c 2 -y obw -z 600\n";
+
+struct cmd_options {
+	int channels;
+	int endian_swap;
+	int frame_length;
+	int has_header;
+	int io_uring;
+	int checksum;
+	int single;
+	int planning;
+	int threads;
+	int workers;
+
+	int segment;
+	int hop;
+	int averages;
+	int band_limited;
+	int fraction;
+
+	bool octave_bands;
+	bool frequency_bins;
+	bool wav_files;
+	int duration;
+
+	int sample_rate;
+	int sensors;
+	int verbose;
+
+	char port_number[16];
+	char server_name[256];
+	char url[256];
+	char wisdom[256];
+};
+
+static void cmd_options_init(struct cmd_options *cmd) {
+	cmd->channels = 1;
+	cmd->endian_swap = 0;
+	cmd->frame_length = 1000;
+	cmd->has_header = 1;
+	cmd->io_uring = 0;
+	cmd->checksum = 0;
+	cmd->single = 0;
+	cmd->planning = 0;
+	cmd->threads = 1;
+	cmd->workers = 1;
+
+	cmd->segment = 0;
+	cmd->hop = 0;
+	cmd->averages = 1;
+	cmd->band_limited = 0;
+	cmd->fraction = 3;
+
+	cmd->octave_bands = true;
+	cmd->frequency_bins = true;
+	cmd->wav_files = true;
+	cmd->duration = 60;
+
+	cmd->sample_rate = 500000;
+	cmd->sensors = 1;
+	cmd->verbose = 0;
+
+	memset(cmd->port_number, '\0', sizeof(cmd->port_number));
+	strcpy(cmd->port_number, "1234");
+
+	memset(cmd->server_name, '\0', sizeof(cmd->server_name));
+	strcpy(cmd->server_name, "127.0.0.1");
+
+	memset(cmd->url, '\0', sizeof(cmd->url));
+	strcpy(cmd->url, "http://localhost:5100/data");
+
+	memset(cmd->wisdom, '\0', sizeof(cmd->wisdom));
+}
+
+static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
+	if ((argc == 2) &&
+	    ((strcmp("-h", argv[1]) == 0) || (strcmp("--help", argv[1]) == 0))) {
+		flush(stdout, "%s\n", cmd_options_help);
+		flush(stdout, "%s\n", sample_usage);
+		exit(EXIT_SUCCESS);
+	}
+
+	int c;
+	while ((c = getopt(argc, argv, cmd_options_available)) != -1) {
+		switch(c) {
+			case 'a':  cmd->averages       = atoi(optarg);  break;
+			case 'b':  cmd->band_limited   = atoi(optarg);  break;
+			case 'c':  cmd->channels       = atoi(optarg);  break;
+			case 'd':  cmd->hop            = atoi(optarg);  break;
+			case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
+			case 'g':  cmd->fraction       = atoi(optarg);  break;
+			case 'h':  cmd->has_header     = atoi(optarg);  break;
+			case 'i':  cmd->io_uring       = atoi(optarg);  break;
+			case 'j':  cmd->workers        = atoi(optarg);  break;
+			case 'k':  cmd->checksum       = atoi(optarg);  break;
+			case 'l':  cmd->planning       = atoi(optarg);  break;
+
+			case 'n':  cmd->segment        = atoi(optarg);  break;
+			case 'o':
+				if (strlen(optarg) < 255) {
+					strcpy(cmd->server_name, optarg);
+				}
+				break;
+
+			case 'p':
+				if (strlen(optarg) < 15) {
+					strcpy(cmd->port_number, optarg);
+				}
+				break;
+
+			case 'r':  cmd->sample_rate    = atoi(optarg);  break;
+			case 's':  cmd->sensors	= atoi(optarg);  break;
+			case 't':  cmd->threads        = atoi(optarg);  break;
+
+			case 'u':
+				if (strlen(optarg) < 255) {
+					strcpy(cmd->url, optarg);
+				}
+				break;
+
+			case 'v':  cmd->verbose	= atoi(optarg);  break;
+
+			case 'w':
+				if (strlen(optarg) < 255) {
+					strcpy(cmd->wisdom, optarg);
+				}
+				break;
+
+			case 'x':  cmd->single         = atoi(optarg);  break;
+
+			case 'y':
+				cmd->octave_bands   = (strchr(optarg, 'o') != NULL);
+				cmd->frequency_bins = (strchr(optarg, 'b') != NULL);
+				cmd->wav_files      = (strchr(optarg, 'w') != NULL);
+				break;
+
+			case 'z':  cmd->duration       = atoi(optarg);  break;
+			default:
+				flush(stdout, "%s\n", cmd_options_help);
+				flush(stdout, "%s\n", sample_usage);
+				exit(EXIT_SUCCESS);
+		}
+	}
+}
+
+static void cmd_options_print(struct cmd_options *cmd) {
+	flush(stdout, "[a] averages     : %d", cmd->averages);
+	flush(stdout, "[b] band limited : %d (%s)", cmd->band_limited, (cmd->band_limited == 1 ? "yes" : "no"));
+	flush(stdout, "[c] channels     : %d", cmd->channels);
+	flush(stdout, "[d] hop          : %d", cmd->hop);
+	flush(stdout, "[e] endian swap  : %d (%s)", cmd->endian_swap, (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length : %d ms", cmd->frame_length);
+	flush(stdout, "[g] fraction     : 1/%d octave", cmd->fraction);
+	flush(stdout, "[h] has header   : %d (%s)", cmd->has_header, (cmd->has_header == 1 ? "yes" : "no"));
+	flush(stdout, "[i] io_uring     : %d (%s)", cmd->io_uring, (cmd->io_uring == 1 ? "yes" : "no"));
+	flush(stdout, "[j] workers      : %d", cmd->workers);
+	flush(stdout, "[k] checksum     : %d (%s)", cmd->checksum, (cmd->checksum == 1 ? "yes" : "no"));
+	flush(stdout, "[l] planning     : %d (%s)", cmd->planning, (cmd->planning == 2 ? "patient" : (cmd->planning == 1 ? "measure" : "estimate")));
+	flush(stdout, "[n] segment      : %d", cmd->segment);
+	flush(stdout, "[o] origin ip    : %s", cmd->server_name);
+	flush(stdout, "[p] port number  : %s", cmd->port_number);
+
+	flush(stdout, "[r] sample rate  : %d", cmd->sample_rate);
+	flush(stdout, "[s] sensors      : %d", cmd->sensors);
+	flush(stdout, "[t] threads      : %d", cmd->threads);
+	flush(stdout, "[u] url          : %s", cmd->url);
+	flush(stdout, "[v] verbose      : %d (%s)", cmd->verbose, (cmd->verbose == 1 ? "yes" : "no"));
+	flush(stdout, "[w] wisdom       : %s", (cmd->wisdom[0] != '\0') ? cmd->wisdom : "none");
+	flush(stdout, "[x] single       : %d (%s)", cmd->single, (cmd->single == 1 ? "yes" : "no"));
+	flush(stdout, "[y] outputs      : %s%s%s", (cmd->octave_bands ? "octave bands " : ""), (cmd->frequency_bins ? "frequency bins " : ""), (cmd->wav_files ? "wav files" : ""));
+	flush(stdout, "[z] duration     : %d", cmd->duration);
+}
+
+/* one frame, finished by the workers a sensor and channel at a time */
+struct frame_work {
+	const pass_context *pc;
+	pass_array *values;
+	pass_cumulative *cumulative;  /* running sums of each spectrum, every output is read from them */
+	pass_array *bands;       /* what is posted, one per sensor and channel, or NULL */
+	pass_array *bins;
+	pass_fftw_plan *plans;   /* one per worker, or the batched plan */
+	bool batched;            /* values already hold the power spectra */
+	pass_welch *welch;       /* one per sensor and channel, or NULL */
+	const char *url;
+
+	int band_lower;
+	int band_upper;
+
+	int bin_lower;
+	int bin_upper;
+	int bin_stride;
+};
+
+static void channel_process(void *data, int task, int worker) {
+	struct frame_work *work = data;
+	pass_array *v = &(work->values[task]);
+	pass_cumulative *cumulative = &(work->cumulative[task]);
+	pass_fftw_plan *plan = &(work->plans[work->batched ? 0 : worker]);
+
+	int sensor = task / work->pc->channel_count;
+	int channel = task % work->pc->channel_count;
+
+	if (work->welch != NULL) {
+		if (pass_welch_execute(&(work->welch[task]), v, plan) != PASS_SUCCESS)
+			return;
+	} else if (!work->batched) {
+		pass_fftw_execute(v, plan);
+	}
+
+	pass_cumulative_execute(cumulative, v);
+
+	char name[128];
+	snprintf(name, sizeof(name), "Sensor %d, Channel %d", sensor, channel);
+
+	if (work->bands != NULL) {
+		pass_array *o = &(work->bands[task]);
+
+		pass_cumulative_bands(cumulative, o, plan, work->band_lower, work->band_upper);
+		pass_decibels(o, 1.0, 0.0);
+		pass_curl_post(work->url, o, name, "octavebands", sensor, channel);
+	}
+
+	if (work->bins != NULL) {
+		pass_array *o = &(work->bins[task]);
+
+		pass_cumulative_bins(cumulative, o, work->bin_lower, work->bin_upper, work->bin_stride);
+		pass_decibels(o, 1.0, 0.0);
+		pass_curl_post(work->url, o, name, "frequencybins", sensor, channel);
+	}
+}
+
+static pass_array *outputs_allocate(const int count, const int size, const bool single) {
+	pass_array *arrays = malloc(sizeof(pass_array) * count);
+	exit_failure_if(arrays == NULL, "failed to allocate memory");
+
+	for (int i = 0; i < count; i++) {
+		pass_response pr;
+
+		if (single)
+			pr = pass_array_allocate_single(&arrays[i], size);
+		else
+			pr = pass_array_allocate(&arrays[i], size);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	}
+
+	return arrays;
+}
+
+static void outputs_free(pass_array *arrays, const int count) {
+	if (arrays == NULL)
+		return;
+
+	for (int i = 0; i < count; i++) {
+		pass_response pr = pass_array_free(&arrays[i]);
+		exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+	}
+	free(arrays);
+}
+
+static volatile int proceed = 1;
+static volatile int result = 0;
+
+void leave(int sig) {
+	proceed = 0;
+	result = sig;
+}
+
+int main(int argc, char **argv) {
+	struct cmd_options cmd;
+
+	cmd_options_init(&cmd);
+	cmd_options_parse(&cmd, argc, argv);
+	cmd_options_print(&cmd);
+
+	signal(SIGINT, leave);
+	signal(SIGTERM, leave);
+
+	double gradient = 1.0;
+	double offset = 0.0;
+
+	pass_response pr;
+
+	pass_context pc;
+	long frame_samples = ((long)(cmd.sample_rate) * cmd.frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd.frame_length, cmd.sample_rate, frame_samples);
+	int frame_size = (int)(frame_samples);
+	int flags = 0;
+	if (cmd.io_uring == 1)
+		flags |= PASS_FLAG_IO_URING;
+	if (cmd.checksum == 1)
+		flags |= PASS_FLAG_CHECKSUM;
+	if (cmd.endian_swap == 1)
+		flags |= PASS_FLAG_ENDIAN_SWAP;
+
+	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, frame_size, cmd.has_header, flags);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to init pass_context");
+
+	int streams = pc.sensor_count * pc.channel_count;
+	bool spectra = cmd.octave_bands || cmd.frequency_bins;
+
+	exit_failure_if((!spectra) && (!cmd.wav_files), "no outputs, -y takes any of o, b and w");
+
+	/* the wav files are written from the raw samples, ahead of the workers */
+	pass_wav_description *wav_descriptions = NULL;
+	if (cmd.wav_files) {
+		wav_descriptions = malloc(sizeof(pass_wav_description) * streams);
+		exit_failure_if((wav_descriptions == NULL), "failed to allocate memory");
+
+		for (int i = 0, k = 0; i < pc.sensor_count; i++) {
+			for (int j = 0; j < pc.channel_count; j++) {
+				char base[64];
+				memset(base, '\0', 64);
+				snprintf(base, 63, "sensor%dchannel%d", i, j);
+
+				pr = pass_wav_init(&wav_descriptions[k], "./", base, 32767.0, cmd.duration);
+				exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+				k++;
+			}
+		}
+	}
+
+	pass_array *values = NULL;
+	pass_cumulative *cumulative = NULL;
+	pass_array *bands = NULL;
+	pass_array *bins = NULL;
+	double *gradients = NULL;
+	double *offsets = NULL;
+	pass_welch *welch = NULL;
+	pass_fftw_plan *plans = NULL;
+	int plan_count = (cmd.workers > 1) ? cmd.workers : 1;
+	bool batched = false;
+
+	int band_lower = 0;
+	int band_upper = 0;
+	int bin_lower = 0;
+	int bin_upper = 0;
+	int bin_stride = 1;
+
+	if (spectra) {
+		values = outputs_allocate(streams, pc.frame_size, (cmd.single == 1));
+
+		gradients = malloc(sizeof(double) * streams);
+		offsets = malloc(sizeof(double) * streams);
+		exit_failure_if((gradients == NULL) || (offsets == NULL), "failed to allocate memory");
+		for (int i = 0; i < streams; i++) {
+			gradients[i] = gradient;
+			offsets[i] = offset;
+		}
+
+		if (cmd.wisdom[0] != '\0') {
+			pr = pass_fftw_wisdom(cmd.wisdom);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to set wisdom file");
+		}
+
+		if (cmd.threads > 1) {
+			pr = pass_fftw_threads(cmd.threads);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to init fftw threads");
+		}
+
+		int plan_flags = 0;
+		if (cmd.single == 1)
+			plan_flags |= PASS_PLAN_SINGLE;
+		if (cmd.planning == 1)
+			plan_flags |= PASS_PLAN_MEASURE;
+		if (cmd.planning == 2)
+			plan_flags |= PASS_PLAN_PATIENT;
+
+		/* welch segments replace the frame as the transform */
+		int transform_size = pc.frame_size;
+		if (cmd.segment > 0) {
+			exit_failure_if(cmd.single == 1, "welch averaging is double precision only");
+
+			if (cmd.hop <= 0)
+				cmd.hop = (cmd.segment > 1) ? cmd.segment / 2 : 1;
+
+			welch = malloc(sizeof(pass_welch) * streams);
+			exit_failure_if(welch == NULL, "failed to allocate memory");
+			for (int i = 0; i < streams; i++) {
+				pr = pass_welch_init(&welch[i], cmd.segment, cmd.hop, cmd.averages);
+				exit_failure_if(pr != PASS_SUCCESS, "failed to init welch averaging");
+			}
+
+			transform_size = cmd.segment;
+		}
+
+		/* the bands from 10 Hz to 4 kHz, as multi_octave_bands */
+		exit_failure_if(cmd.fraction < 1, "invalid fraction");
+		band_lower = pass_octave_band_number(cmd.fraction, 10.0);
+		band_upper = pass_octave_band_number(cmd.fraction, pow(10.0, 3.6));
+
+		// 1 Hz to 1000 Hz in 5 Hz steps, as multi_frequency_bins
+		bin_lower  = (int)(((long)(1) * transform_size) / pc.sample_rate);
+		bin_upper  = (int)(((long)(1000) * transform_size) / pc.sample_rate);
+		bin_stride = (int)(((long)(5) * transform_size) / pc.sample_rate);
+		if (bin_lower < 1)
+			bin_lower = 1;
+		if (bin_stride < 1)
+			bin_stride = 1;
+
+		int bin_count = ((bin_upper - bin_lower) + bin_stride - 1) / bin_stride;
+
+		if (cmd.octave_bands)
+			bands = outputs_allocate(streams, band_upper - band_lower, (cmd.single == 1));
+		if (cmd.frequency_bins)
+			bins = outputs_allocate(streams, bin_count, (cmd.single == 1));
+
+		/* the highest bin needed is the larger of what either output posts */
+		double lowest = 0.0;
+		double highest = 0.0;
+		if (cmd.octave_bands)
+			highest = pow(10.0, (36 + 0.5) / 10.0);
+		if (cmd.frequency_bins)
+			highest = fmax(highest, ((double)(bin_upper + bin_stride) * pc.sample_rate) / transform_size);
+
+		/* a single worker transforms the whole frame in one batch, more each get a plan */
+		bool pruned = (cmd.band_limited == 1) && (welch == NULL);
+		batched = (cmd.workers <= 1) && (welch == NULL) && (!pruned);
+		if (pruned && (cmd.workers <= 1))
+			info(stdout, "-b 1: pruned plans are not batched, -b 0 batches the transforms of a single worker");
+		if (pruned && (cmd.single == 1))
+			info(stdout, "-b 1: pruned plans transform in double, only the arrays are float32");
+		plans = malloc(sizeof(pass_fftw_plan) * plan_count);
+		exit_failure_if(plans == NULL, "failed to allocate memory");
+
+		if (!batched) {
+			for (int i = 0; i < plan_count; i++) {
+				if (pruned)
+					pr = pass_fftw_plan_init_pruned(&plans[i], pc.sample_rate, transform_size, lowest, highest, plan_flags);
+				else
+					pr = pass_fftw_plan_init(&plans[i], pc.sample_rate, transform_size, plan_flags);
+				exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+			}
+		} else {
+			pr = pass_fftw_plan_init_many(&plans[0], pc.sample_rate, pc.frame_size, streams, plan_flags);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+		}
+
+		for (int i = 0; i < (batched ? 1 : plan_count); i++) {
+			if (cmd.fraction != 3) {
+				pr = pass_fftw_plan_bands(&plans[i], cmd.fraction);
+				exit_failure_if(pr != PASS_SUCCESS, "failed to generate bands");
+			}
+		}
+
+		cumulative = malloc(sizeof(pass_cumulative) * streams);
+		exit_failure_if(cumulative == NULL, "failed to allocate memory");
+		for (int i = 0; i < streams; i++) {
+			pr = pass_cumulative_init(&cumulative[i], plans[0].output_rate);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+		}
+	}
+
+	pass_pool pool;
+	pr = pass_pool_init(&pool, plan_count);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to start workers");
+
+	pr = pass_curl_init();
+	exit_failure_if(pr != PASS_SUCCESS, "failed to init curl");
+
+	struct frame_work work = {
+		.pc = &pc,
+		.values = values,
+		.cumulative = cumulative,
+		.bands = bands,
+		.bins = bins,
+		.plans = plans,
+		.batched = batched,
+		.welch = welch,
+		.url = cmd.url,
+		.band_lower = band_lower,
+		.band_upper = band_upper,
+		.bin_lower = bin_lower,
+		.bin_upper = bin_upper,
+		.bin_stride = bin_stride,
+	};
+
+	pr = pass_connect(&pc, cmd.server_name, cmd.port_number);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to connect");
+
+	while ((proceed) &&
+	      ((pr = pass_read(&pc)) == PASS_SUCCESS)) {
+
+		/* a read can complete more than one frame, each is taken in turn */
+		while ((proceed) &&
+		      ((pr = pass_gaps_detection(&pc)) != PASS_FAILURE_NO_DATA)) {
+
+			if (pr == PASS_FAILURE_CHECKSUM) {
+				info(stdout, "frame %lu failed the checksum, dropped", (unsigned long)pc.sequence_id);
+				continue;
+			}
+			if (pr != PASS_SUCCESS) {
+				info(stdout, "gap detected");
+				continue;
+			}
+
+			if (wav_descriptions != NULL) {
+				for (int i = 0, k = 0; i < pc.sensor_count; i++) {
+					for (int j = 0; j < pc.channel_count; j++) {
+						pass_wav_write(&pc, &wav_descriptions[k], i, j);
+						k++;
+					}
+				}
+			}
+
+			if (!spectra)
+				continue;
+
+			if (work.batched)
+				pass_fftw_execute_many(values, &pc, &plans[0], gradients, offsets);
+			else
+				pass_deinterleave(values, &pc, gradients, offsets);
+
+			pass_pool_run(&pool, channel_process, &work, streams);
+		}
+	}
+
+	if (pc.frames_lost != 0)
+		info(stdout, "lost %lu frames, %lu fragments", (unsigned long)pc.frames_lost, (unsigned long)pc.fragments_lost);
+	if (pc.frames_corrupt != 0)
+		info(stdout, "dropped %lu frames failing the checksum", (unsigned long)pc.frames_corrupt);
+
+	pass_close(&pc);
+
+	pr = pass_pool_term(&pool);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to stop workers");
+
+	pr = pass_curl_term();
+	exit_failure_if(pr != PASS_SUCCESS, "failed to release curl");
+
+	if (plans != NULL) {
+		for (int i = 0; i < plan_count; i++) {
+			pr = pass_fftw_plan_term(&plans[i]);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+		}
+		free(plans);
+	}
+
+	if (cumulative != NULL) {
+		for (int i = 0; i < streams; i++)
+			pass_cumulative_term(&cumulative[i]);
+		free(cumulative);
+	}
+
+	if (welch != NULL) {
+		for (int i = 0; i < streams; i++)
+			pass_welch_term(&welch[i]);
+		free(welch);
+	}
+
+	if (wav_descriptions != NULL) {
+		for (int i = 0; i < streams; i++) {
+			pr = pass_wav_term(&wav_descriptions[i]);
+			exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+		}
+		free(wav_descriptions);
+	}
+
+	outputs_free(values, streams);
+	outputs_free(bands, streams);
+	outputs_free(bins, streams);
+	free(gradients);
+	free(offsets);
+
+	pr = pass_context_free(&pc);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+
+	return 0;
+}
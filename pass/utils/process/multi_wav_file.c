@@ -1,5 +1,6 @@
 // author john.d.sheehan@ie.ibm.com
 
+#include <limits.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,13 +14,16 @@
 #include "pass.h"
 
 
-const char *cmd_options_available = "c:d:e:h:o:p:r:s:v:";
+const char *cmd_options_available = "c:d:e:f:h:i:k:o:p:r:s:v:";
 
 const char *cmd_options_help = "\
 -c: channels (number of channels, default 1)\n\
 -d: duration (durationn of wav files, default 60 seconds)\n\
 -e: endian swap (0 - no swap, 1 - swap, default 0)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
 -h: has header (0 - no header, 1 - header, default 1)\n\
+-i: io_uring (0 - read, 1 - io_uring when the kernel supports it, default 0)\n\
+-k: checksum (0 - ignore, 1 - drop frames not matching the header checksum, default 0)\n\
 -o: origin ip (default 127.0.0.1)\n\
 -p: port number (default 1234)\n\
 -r: sample rate (default 500000)\n\
@@ -34,7 +38,10 @@ struct cmd_options {
 	int channels;
 	int duration;
 	int endian_swap;
+	int frame_length;
 	int has_header;
+	int io_uring;
+	int checksum;
 
 	int sample_rate;
 	int sensors;
@@ -48,7 +55,10 @@ static void cmd_options_init(struct cmd_options *cmd) {
 	cmd->channels = 1;
 	cmd->duration = 60;
 	cmd->endian_swap = 0;
+	cmd->frame_length = 1000;
 	cmd->has_header = 1;
+	cmd->io_uring = 0;
+	cmd->checksum = 0;
 
 	cmd->sample_rate = 500000;
 	cmd->sensors = 1;
@@ -75,7 +85,10 @@ static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
 			case 'c':  cmd->channels       = atoi(optarg);  break;
 			case 'd':  cmd->duration       = atoi(optarg);  break;
 			case 'e':  cmd->endian_swap    = atoi(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
 			case 'h':  cmd->has_header     = atoi(optarg);  break;
+			case 'i':  cmd->io_uring       = atoi(optarg);  break;
+			case 'k':  cmd->checksum       = atoi(optarg);  break;
 
 			case 'o':
 				if (strlen(optarg) < 255) {
@@ -104,8 +117,11 @@ static void cmd_options_print(struct cmd_options *cmd) {
 	flush(stdout, "[c] channels     : %d", cmd->channels);
 	flush(stdout, "[d] duration     : %d", cmd->duration);
 	flush(stdout, "[e] endian swap  : %d (%s)", cmd->endian_swap, (cmd->endian_swap == 1 ? "yes" : "no"));
+	flush(stdout, "[f] frame length : %d ms", cmd->frame_length);
 
 	flush(stdout, "[h] has header   : %d (%s)", cmd->has_header, (cmd->has_header == 1 ? "yes" : "no"));
+	flush(stdout, "[i] io_uring     : %d (%s)", cmd->io_uring, (cmd->io_uring == 1 ? "yes" : "no"));
+	flush(stdout, "[k] checksum     : %d (%s)", cmd->checksum, (cmd->checksum == 1 ? "yes" : "no"));
 	flush(stdout, "[o] origin ip    : %s", cmd->server_name);
 	flush(stdout, "[p] port number  : %s", cmd->port_number);
 
@@ -135,7 +151,18 @@ int main(int argc, char **argv){
 	pass_response pr;
 
 	pass_context pc;
-	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, cmd.has_header);
+	long frame_samples = ((long)(cmd.sample_rate) * cmd.frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd.frame_length, cmd.sample_rate, frame_samples);
+	int frame_size = (int)(frame_samples);
+	int flags = 0;
+	if (cmd.io_uring == 1)
+		flags |= PASS_FLAG_IO_URING;
+	if (cmd.checksum == 1)
+		flags |= PASS_FLAG_CHECKSUM;
+	if (cmd.endian_swap == 1)
+		flags |= PASS_FLAG_ENDIAN_SWAP;
+
+	pr = pass_context_init(&pc, cmd.sensors, cmd.channels, cmd.sample_rate, frame_size, cmd.has_header, flags);
 	exit_failure_if(pr != PASS_SUCCESS, "failed to init pass_context");
 
 	pr = pass_connect(&pc, cmd.server_name, cmd.port_number);
@@ -160,25 +187,33 @@ int main(int argc, char **argv){
 	while ((proceed) &&
 	      ((pr = pass_read(&pc)) == PASS_SUCCESS)) {
 
-		if (cmd.has_header) {
-			pr = pass_gaps_detection(&pc);
+		/* a read can complete more than one frame, each is taken in turn */
+		while ((proceed) &&
+		      ((pr = pass_gaps_detection(&pc)) != PASS_FAILURE_NO_DATA)) {
+
+			if (pr == PASS_FAILURE_CHECKSUM) {
+				info(stdout, "frame %lu failed the checksum, dropped", (unsigned long)pc.sequence_id);
+				continue;
+			}
 			if (pr != PASS_SUCCESS) {
 				info(stdout, "gap detected");
 				continue;
 			}
-		}
 
-		if (cmd.endian_swap)
-			pass_endian_swap(&pc);
-
-		for (int i = 0, k = 0; i < pc.sensor_count; i++) {
-			for (int j = 0; j < pc.channel_count; j++) {
-				pass_wav_write(&pc, &wav_descriptions[k], i, j);
-				k++;
+			for (int i = 0, k = 0; i < pc.sensor_count; i++) {
+				for (int j = 0; j < pc.channel_count; j++) {
+					pass_wav_write(&pc, &wav_descriptions[k], i, j);
+					k++;
+				}
 			}
 		}
 	}
 
+	if (pc.frames_lost != 0)
+		info(stdout, "lost %lu frames, %lu fragments", (unsigned long)pc.frames_lost, (unsigned long)pc.fragments_lost);
+	if (pc.frames_corrupt != 0)
+		info(stdout, "dropped %lu frames failing the checksum", (unsigned long)pc.frames_corrupt);
+
 	pass_close(&pc);
 
 	for (int i = 0; i < (pc.sensor_count * pc.channel_count); i++) {
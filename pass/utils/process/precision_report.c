@@ -0,0 +1,213 @@
+// author john.d.sheehan@ie.ibm.com
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "pass.h"
+
+
+const char *cmd_options_available = "a:f:r:";
+
+const char *cmd_options_help = "\
+-a: amplitude (fraction of full scale of the test tones, default 0.01)\n\
+-f: frame length (milliseconds of samples in each frame, default 1000)\n\
+-r: sample rate (default 500000)\n";
+
+const char *sample_usage = "\
+sample args:\n\
+compare the float32 and double pipelines on one second frames at 48000 samples per second: -r 48000 -f 1000\n";
+
+struct cmd_options {
+	int frame_length;
+	int sample_rate;
+
+	double amplitude;
+};
+
+static void cmd_options_init(struct cmd_options *cmd) {
+	cmd->frame_length = 1000;
+	cmd->sample_rate = 500000;
+
+	cmd->amplitude = 0.01;
+}
+
+static void cmd_options_parse(struct cmd_options *cmd, int argc, char **argv) {
+	if ((argc == 2) &&
+	    ((strcmp("-h", argv[1]) == 0) || (strcmp("--help", argv[1]) == 0))) {
+		flush(stdout, "%s\n", cmd_options_help);
+		flush(stdout, "%s\n", sample_usage);
+		exit(EXIT_SUCCESS);
+	}
+
+	int c;
+	while ((c = getopt(argc, argv, cmd_options_available)) != -1) {
+		switch(c) {
+			case 'a':  cmd->amplitude      = atof(optarg);  break;
+			case 'f':  cmd->frame_length   = atoi(optarg);  break;
+			case 'r':  cmd->sample_rate    = atoi(optarg);  break;
+			default:
+				flush(stdout, "%s\n", cmd_options_help);
+				flush(stdout, "%s\n", sample_usage);
+				exit(EXIT_SUCCESS);
+		}
+	}
+}
+
+static void cmd_options_print(struct cmd_options *cmd) {
+	flush(stdout, "[a] amplitude    : %.04f", cmd->amplitude);
+	flush(stdout, "[f] frame length : %d ms", cmd->frame_length);
+	flush(stdout, "[r] sample rate  : %d", cmd->sample_rate);
+}
+
+/* a tone, white noise or both, as the emitters would send them */
+static void signal_generate(short *payload, int count, int sample_rate, double frequency, double amplitude, double noise) {
+	for (int i = 0; i < count; i++) {
+		double t = (double)(i) / (double)(sample_rate);
+		double r = amplitude * sin(2.0 * M_PI * frequency * t);
+		r += noise * (((double)(rand()) / RAND_MAX) * 2.0 - 1.0);
+
+		payload[i] = (short)(32767.0 * r);
+	}
+}
+
+/*
+ * Largest and mean absolute difference in dB, over the values within
+ * PRECISION_RANGE of the peak. Further down a pure tone only leaves rounding
+ * noise, around -300 dB in double and -150 dB in float, which is not signal.
+ */
+#define PRECISION_RANGE  100.0
+
+static void compare(const char *name, const pass_array *d, const pass_array *f) {
+	double largest = 0.0;
+	double total = 0.0;
+	int count = 0;
+
+	double peak = -INFINITY;
+	for (int i = 0; i < d->count; i++) {
+		if (isfinite(d->values[i]) && (d->values[i] > peak))
+			peak = d->values[i];
+	}
+
+	for (int i = 0; i < d->count && i < f->count; i++) {
+		if (!isfinite(d->values[i]) || !isfinite(f->values_f[i]))
+			continue;
+
+		if (d->values[i] < peak - PRECISION_RANGE)
+			continue;
+
+		double delta = fabs(d->values[i] - (double)(f->values_f[i]));
+		if (delta > largest)
+			largest = delta;
+
+		total += delta;
+		count++;
+	}
+
+	flush(stdout, "%-24s %8d %14.3e %14.3e", name, count, largest, (count > 0) ? total / count : 0.0);
+}
+
+int main(int argc, char **argv) {
+	struct cmd_options cmd;
+
+	cmd_options_init(&cmd);
+	cmd_options_parse(&cmd, argc, argv);
+	cmd_options_print(&cmd);
+
+	pass_response pr;
+
+	pass_context pc;
+	long frame_samples = ((long)(cmd.sample_rate) * cmd.frame_length) / 1000;
+	exit_failure_if((frame_samples < 1) || (frame_samples > INT_MAX), "-f %d ms at %d samples per second gives %ld samples a frame", cmd.frame_length, cmd.sample_rate, frame_samples);
+	int frame_size = (int)(frame_samples);
+
+	pr = pass_context_init(&pc, 1, 1, cmd.sample_rate, frame_size, false, 0);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to init pass_context");
+
+	short *payload = malloc(sizeof(short) * frame_size);
+	exit_failure_if(payload == NULL, "failed to allocate memory");
+	pc.payload = payload;
+
+	pass_array d, f;
+	pr = pass_array_allocate(&d, frame_size);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	pr = pass_array_allocate_single(&f, frame_size);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+
+	pass_array bands_d, bands_f;
+	pr = pass_array_allocate(&bands_d, 36 - 10);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	pr = pass_array_allocate_single(&bands_f, 36 - 10);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+
+	pass_fftw_plan plan_d, plan_f;
+	pr = pass_fftw_plan_init(&plan_d, pc.sample_rate, pc.frame_size, 0);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+	pr = pass_fftw_plan_init(&plan_f, pc.sample_rate, pc.frame_size, PASS_PLAN_SINGLE);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to allocate memory");
+
+	double gradient = 1.0;
+	double offset = 0.0;
+
+	struct {
+		const char *name;
+		double frequency;
+		double amplitude;
+		double noise;
+	} signals[] = {
+		{ "tone 256 Hz",    256.0,  cmd.amplitude, 0.0 },
+		{ "tone 2048 Hz",   2048.0, cmd.amplitude, 0.0 },
+		{ "tone full scale", 1000.0, 0.99,         0.0 },
+		{ "tone and noise", 2048.0, cmd.amplitude, cmd.amplitude / 10.0 },
+		{ "noise",          0.0,    0.0,           cmd.amplitude },
+	};
+
+	flush(stdout, "\ndecibel difference of float32 from double, within %.0f dB of the peak", PRECISION_RANGE);
+	flush(stdout, "%-24s %8s %14s %14s", "signal / output", "values", "largest", "mean");
+
+	for (size_t s = 0; s < sizeof(signals) / sizeof(signals[0]); s++) {
+		char name[64];
+
+		signal_generate(payload, frame_size, cmd.sample_rate, signals[s].frequency, signals[s].amplitude, signals[s].noise);
+
+		pass_deinterleave(&d, &pc, &gradient, &offset);
+		pass_deinterleave(&f, &pc, &gradient, &offset);
+		pass_fftw_execute(&d, &plan_d);
+		pass_fftw_execute(&f, &plan_f);
+		pass_octave_bands(&d, &bands_d, &plan_d, 10, 36);
+		pass_octave_bands(&f, &bands_f, &plan_f, 10, 36);
+		pass_decibels(&bands_d, 1.0, 0.0);
+		pass_decibels(&bands_f, 1.0, 0.0);
+
+		snprintf(name, sizeof(name), "%s, bands", signals[s].name);
+		compare(name, &bands_d, &bands_f);
+
+		pass_deinterleave(&d, &pc, &gradient, &offset);
+		pass_deinterleave(&f, &pc, &gradient, &offset);
+		pass_fftw_execute(&d, &plan_d);
+		pass_fftw_execute(&f, &plan_f);
+		pass_decibels(&d, 1.0, 0.0);
+		pass_decibels(&f, 1.0, 0.0);
+
+		snprintf(name, sizeof(name), "%s, bins", signals[s].name);
+		compare(name, &d, &f);
+	}
+
+	pass_fftw_plan_term(&plan_f);
+	pass_fftw_plan_term(&plan_d);
+	pass_array_free(&bands_f);
+	pass_array_free(&bands_d);
+	pass_array_free(&f);
+	pass_array_free(&d);
+
+	free(payload);
+
+	pr = pass_context_free(&pc);
+	exit_failure_if(pr != PASS_SUCCESS, "failed to release memory");
+
+	return 0;
+}